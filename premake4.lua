@@ -25,7 +25,8 @@ solution "gKit2light"
 		buildoptions { "-W -Wall -Wextra -Wsign-compare -Wno-unused-parameter -Wno-unused-function -Wno-unused-variable", "-pipe" }
 		buildoptions { "-flto"}
 		linkoptions { "-flto"}
-		links { "GLEW", "SDL2", "SDL2_image", "GL" }
+		defines { "USE_ZLIB" }
+		links { "GLEW", "SDL2", "SDL2_image", "GL", "z" }
 
 	configuration { "linux", "debug" }
 		buildoptions { "-g"}
@@ -76,9 +77,9 @@ solution "gKit2light"
 	configuration "macosx"
 		frameworks= "-F /Library/Frameworks/"
 		buildoptions { "-std=c++11" }
-		defines { "GK_MACOS" }
+		defines { "GK_MACOS", "USE_ZLIB" }
 		buildoptions { frameworks }
-		linkoptions { frameworks .. " -framework OpenGL -framework SDL2 -framework SDL2_image" }
+		linkoptions { frameworks .. " -framework OpenGL -framework SDL2 -framework SDL2_image -lz" }
 
 
  -- description des fichiers communs
@@ -1,106 +1,25 @@
+/**
+ * @file BinaryTree.cpp
+ */
 #include "BinaryTree.hpp"
 #include <algorithm>
-#include <initializer_list>
-#include <utility>
-#include <array>
-#include <functional>
-#include <stack>
-#include <fstream>
+#include <cmath>
 
 
 namespace 
 {
     typedef BinaryTree::Node Node; //!< C'est quand meme moins long à écrire ncp ?
     
-    /**
-     * @brief Permet de simplifier les calculs des t*min/max en les cachant dans une fonction.
-     * Effectue le calcul des min/max en swappant les deux valeurs si min est supérieur à max.
-     * @param[out] min  La valeur minimale obtenue après calcul,            pour la bonne coordonné.
-     * @param[out] max  La valeur maximale obtenue après calcul,            pour la bonne coordonné.
-     * @param[in]  pmin La valeur du point minimale de la boite englobante, pour la bonne coordonné.
-     * @param[in]  pmax La valeur du point maximale de la boite englobante, pour la bonne coordonné.
-     * @param[in]  rayo La valeur du point d'origine du rayon,              pour la bonne coordonné.
-     * @param[in]  rayd La valeur de la direction du rayon,                 pour la bonne coordonné.
-     */
-    void affect_max_min(float& min, float& max,
-                        const float pmin, const float pmax, const float rayo, const float rayd) noexcept
-    {
-        min = (pmin - rayo)/rayd;
-        max = (pmax - rayo)/rayd;
-        if (min > max)
-        {
-            std::swap(min, max);
-        }
-    }
-    /**
-     * @brief Embarque des comparaisons et réaffectations pour le calcul de l'intersections de la boite englobante.
-     * @param[out] min      La valeur minimale obtenue après calcul,            pour la bonne coordonné.
-     * @param[out] max      La valeur maximale obtenue après calcul,            pour la bonne coordonné.
-     * @param[in]  othermin L'autre valeur de min (pour une autre coordonné) avec laquelle comparer.
-     * @param[in]  othermax L'autre valeur de max (pour une autre coordonné) avec laquelle comparer.
-     * @return true si la comparaison aboutie à un souci (il faut alors sortir du calcul), false sinon.
-     */
-    bool compare_max_min(float& min, float& max, const float othermin, const float othermax) noexcept
-    {
-        if (min > othermax || othermin > max)
-        {
-            return true;
-        }
-        min = std::max(othermin, min);
-        max = std::min(othermax, max);
-        return false;
-    }
-    
-}
-
-bool BoundingBox::intersect(const Ray& ray) const noexcept
-{
-    float txmin, txmax, tymin, tymax, tzmin, tzmax;
-    affect_max_min(txmin, txmax, this->pmin.x, this->pmax.x, ray.o.x, ray.d.x);
-    affect_max_min(tymin, tymax, this->pmin.y, this->pmax.y, ray.o.y, ray.d.y);
-    affect_max_min(tzmin, tzmax, this->pmin.z, this->pmax.z, ray.o.z, ray.d.z);
-    if (compare_max_min(txmin, txmax, tymin, tymax) || compare_max_min(txmin, txmax, tzmin, tzmax))
-    {
-        return false;
-    }
-    // Ici, on a les bonnes coordonné pour les t[xyz]m[ia][nx] si on veut bosser avec
-    return true;
-}
-
-
-
-void BinaryTree::init(const std::string& fname)
-{
-	this->triangles = &Scene::triangles;
-    if (!this->fromFile(fname))
-    {
-        this->root = this->build_node(0, Scene::triangles.size());// pourquoi 1 au lieu de 0 ?
-        this->dump(fname);
-    }
-}
-
-BinaryTree::Node::Node(const node_ind_t r, const node_ind_t l, const triangle_ind_t t) : right(r), left(l), triangle(t)
-{
-    
-}
-
-BinaryTree::Node BinaryTree::Node::make_leaf(const triangle_ind_t triangleOffset) noexcept
-{
-    return BinaryTree::Node(-1, -1, triangleOffset);
-}
-
-namespace
-{
     /**
      * @brief Décide si on est dans un cas terminal pour la construction du BVH.
      * @details Un cas terminal ----> une feuille.
-     * @param[in] begin L'indice  de départ    lorsque l'on prélève dans le conteneur de triangles.
-     * @param[in] end   L'indice  de fin exclu lorsque l'on prélève dans le conteneur de triangles.
+     * @param[in] begin L'indice  de départ    lorsque l'on prélève dans le conteneur de primitives.
+     * @param[in] end   L'indice  de fin exclu lorsque l'on prélève dans le conteneur de primitives.
      * @return @b true si on est dans un cas terminal, false sinon.
      */
     bool build_terminal_case(triangle_ind_t begin, triangle_ind_t end) noexcept
     {
-        return end - begin <= 1;
+        return end - begin <= BVH_LEAF_SIZE;
     }
     //! Un enum pour les axes.
     enum AXIS {
@@ -138,37 +57,11 @@ namespace
                                                   : lenY;
         return (intermediate > lenZ) ? axis : AXIS::AXIS_Z;
     }
-    /**
-     * @brief Construit une boite englobante @b bbox en ne se basant que sur les triangles de @b triangles
-     * compris entre @b begin et @b end @b exclu !
-     * @param[in]  triangles Un ensemble de triangles.
-     * @param[in]  begin     L'offset       du premier triangle à traiter.
-     * @param[in]  end       L'offset exclu du dernier triangle à traiter.
-     * @param[out] bbox      La boite englobante que l'on va remplir.
-     * @pre @b begin doit etre dans les bornes de @b triangles.
-     * @pre @b end   doit etre dans les bornes de @b triangles.
-     * @throw std::out_of_range Si on sort des limites de @b triangles.
-     */
-    void buildBbox(const std::vector<Triangle>& triangles, int begin, int end, BoundingBox& bbox)
-    {
-        bbox.pmin.x = bbox.pmax.x = triangles.at(begin).a.x;
-        bbox.pmin.y = bbox.pmax.y = triangles.at(begin).a.y;
-        bbox.pmin.z = bbox.pmax.z = triangles.at(begin).a.z;
-        for(int i=begin;i<end;++i)
-        {
-            bbox.pmin.x = std::min({bbox.pmin.x, triangles.at(i).a.x, triangles.at(i).b.x, triangles.at(i).c.x});
-            bbox.pmin.y = std::min({bbox.pmin.y, triangles.at(i).a.y, triangles.at(i).b.y, triangles.at(i).c.y});
-            bbox.pmin.z = std::min({bbox.pmin.z, triangles.at(i).a.z, triangles.at(i).b.z, triangles.at(i).c.z});
-            bbox.pmax.x = std::max({bbox.pmax.x, triangles.at(i).a.x, triangles.at(i).b.x, triangles.at(i).c.x});
-            bbox.pmax.y = std::max({bbox.pmax.y, triangles.at(i).a.y, triangles.at(i).b.y, triangles.at(i).c.y});
-            bbox.pmax.z = std::max({bbox.pmax.z, triangles.at(i).a.z, triangles.at(i).b.z, triangles.at(i).c.z});
-        }
-    }
     /**
      * @brief Trouve la coupure sur l'axe le plus long (qui est @b axis).
      * @param[in] bbox La boite englobante que l'on considère.
      * @param[in] axis L'enum de l'axe le plus long.
-     * @return 
+     * @return Le milieu de la boite sur cet axe.
      */
     float cutOff(const BoundingBox& bbox, AXIS axis) noexcept
     {
@@ -186,114 +79,152 @@ namespace
         }
         return result/2.0f;
     }
+    /**
+     * @brief Donne la coordonnée de @b p sur @b axis.
+     * @param[in] p    Le point.
+     * @param[in] axis L'axe.
+     * @return La coordonnée.
+     */
+    inline float coordinate(const vec3& p, AXIS axis) noexcept
+    {
+        return (axis == AXIS::AXIS_X) ? p.x : (axis == AXIS::AXIS_Y) ? p.y : p.z;
+    }
+}
+
+
+BinaryTree::Node::Node(const node_ind_t r, const node_ind_t l, const triangle_ind_t t, const triangle_ind_t c)
+    : bbox(), right(r), left(l), triangle(t), count(c)
+{
     
 }
 
-node_ind_t BinaryTree::build_node(const triangle_ind_t begin, const triangle_ind_t end)
+BinaryTree::Node BinaryTree::Node::make_leaf(const triangle_ind_t triangleOffset, const triangle_ind_t count) noexcept
 {
-    this->nodes.emplace_back();
-    Node&      node   = this->nodes.back();
-    node_ind_t offset = this->nodes.size() - 1;
-    if (build_terminal_case(begin, end))
+    return BinaryTree::Node(-1, -1, triangleOffset, count);
+}
+
+void BinaryTree::build(const std::vector<BoundingBox>& boxes, std::vector<triangle_ind_t>& order)
+{
+    this->nodes.clear();
+    this->root = 0;
+    order.resize(boxes.size());
+    if (boxes.empty())
     {
-        node.triangle = begin;
+        return;
     }
-    else
+    std::vector<vec3> centers(boxes.size());
+    for(std::size_t i=0;i<boxes.size();++i)
     {
-        buildBbox(*this->triangles, begin, end, node.bbox);
-        AXIS axis = findLongestAxis(node.bbox);
-        float cut = cutOff(node.bbox, axis);
-        Triangle* pmid = std::partition(this->triangles->data() + begin, this->triangles->data() + end, [axis, cut](const Triangle& t) -> bool {
-            Point center = t.point(0.33f, 0.33f);
-            switch(axis)
-            {
-                case AXIS::AXIS_X:
-                    return center.x < cut;
-                case AXIS::AXIS_Y:
-                    return center.y < cut;
-                default:
-                    return center.z < cut;
-            }
-        });
-        triangle_ind_t mid = std::distance(this->triangles->data(), pmid);
-        node.left  = this->build_node(begin, mid);
-        node.right = this->build_node(mid, end);
+        order[i]   = i;
+        centers[i] = boxes[i].center();
     }
-    return offset;
+    this->nodes.reserve(2*(boxes.size()/BVH_LEAF_SIZE + 1));
+    this->root = this->build_node(boxes, centers, order, 0, boxes.size(), 0);
+    this->cost = this->sah();
 }
 
-bool BinaryTree::intersect(const Ray& ray, Hit& hit) const
+void BinaryTree::refit(const std::vector<BoundingBox>& boxes)
 {
-    std::vector<node_ind_t> leaves;
-    std::stack<node_ind_t>  stack;
-    
-    stack.push(this->root);
-    while(!stack.empty())
+    if (this->nodes.empty())
     {
-        node_ind_t current = stack.top();
-        stack.pop();
-        if (this->nodes.at(current).isLeaf())
-        {
-            leaves.push_back(current);
-        }
-        else if(this->nodes.at(current).bbox.intersect(ray))
-        {
-            stack.push(this->nodes.at(current).left);
-            stack.push(this->nodes.at(current).right);
-        }
+        return;
     }
-    if (leaves.empty())
+    #pragma omp parallel
+    {
+        #pragma omp single
+        this->refit_node(boxes, this->root, this->nodes.size());
+    }
+}
+
+bool BinaryTree::update(const std::vector<BoundingBox>& boxes, std::vector<triangle_ind_t>& order, const float rebuild)
+{
+    this->refit(boxes);
+    if (this->sah() <= rebuild*this->cost)
     {
         return false;
     }
-    hit.t = ray.tmax;
-    std::for_each(leaves.begin(), leaves.end(), [&ray, &hit, this](node_ind_t id){
-        float t, u, v;
-        if(this->triangles->at(id).intersect(ray, hit.t, t, u, v))
-        {
-            hit.t = t;
-            hit.u = u;
-            hit.v = v;
-            hit.p = ray(t);
-            hit.n = this->triangles->at(id).normal(u, v);
-            hit.object_id = id;
-        }
-    });
+    this->build(boxes, order);
     return true;
 }
 
-void BinaryTree::dump(const std::string& fname)
+float BinaryTree::sah(void) const
+{
+    if (this->nodes.empty() || this->nodes[this->root].bbox.area() <= 0.0f)
+    {
+        return 0.0f;
+    }
+    const int count = this->nodes.size();
+    float total = 0.0f;
+    #pragma omp parallel for schedule(static) reduction(+:total)
+    for(int i=0;i<count;++i)
+    {
+        const Node& node = this->nodes[i];
+        total += node.bbox.area()*(node.isLeaf() ? node.count : BVH_SAH_TRAVERSAL);
+    }
+    return total/this->nodes[this->root].bbox.area();
+}
+
+node_ind_t BinaryTree::build_node(const std::vector<BoundingBox>& boxes, const std::vector<vec3>& centers,
+                                  std::vector<triangle_ind_t>& order, const triangle_ind_t begin, const triangle_ind_t end,
+                                  int depth)
 {
-    std::ofstream file(fname);
-    file << this->nodes.size() << std::endl;
-    file << this->root << std::endl;
-    std::for_each(this->nodes.begin(), this->nodes.end(), [&file](const BinaryTree::Node& node){
-        file << node.left << ' ' << node.right << ' ' << node.triangle << ' ';
-        file << node.bbox.pmin.x << ' ' << node.bbox.pmin.y << ' ' << node.bbox.pmin.z << ' ';
-        file << node.bbox.pmax.x << ' ' << node.bbox.pmax.y << ' ' << node.bbox.pmax.z << ' ' << std::endl;
+    // Les appels récursifs agrandissent nodes : on garde l'offset, jamais une référence.
+    const node_ind_t offset = this->nodes.size();
+    this->nodes.emplace_back();
+    BoundingBox bbox, centroids;
+    for(triangle_ind_t i=begin;i<end;++i)
+    {
+        bbox.insert(boxes[order[i]]);
+        centroids.insert(centers[order[i]]);
+    }
+    if (build_terminal_case(begin, end))
+    {
+        this->nodes[offset] = Node::make_leaf(begin, end - begin);
+        this->nodes[offset].bbox = bbox;
+        return offset;
+    }
+    const AXIS  axis = findLongestAxis(centroids);
+    const float cut  = cutOff(centroids, axis);
+    triangle_ind_t* first = order.data() + begin;
+    triangle_ind_t* last  = order.data() + end;
+    triangle_ind_t* pmid  = std::partition(first, last, [&centers, axis, cut](triangle_ind_t i) -> bool {
+        return coordinate(centers[i], axis) < cut;
     });
-    
-    file.close();
+    if (pmid == first || pmid == last || depth >= BVH_MEDIAN_DEPTH)
+    {
+        // Centres confondus sur l'axe, ou arbre trop profond : on coupe à la médiane.
+        pmid = first + (end - begin)/2;
+        std::nth_element(first, pmid, last, [&centers, axis](triangle_ind_t a, triangle_ind_t b) -> bool {
+            return coordinate(centers[a], axis) < coordinate(centers[b], axis);
+        });
+    }
+    const triangle_ind_t mid = begin + std::distance(first, pmid);
+    const node_ind_t left  = this->build_node(boxes, centers, order, begin, mid, depth + 1);
+    const node_ind_t right = this->build_node(boxes, centers, order, mid, end, depth + 1);
+    this->nodes[offset] = Node(right, left);
+    this->nodes[offset].bbox = bbox;
+    return offset;
 }
 
-bool BinaryTree::fromFile(const std::string& fname)
+void BinaryTree::refit_node(const std::vector<BoundingBox>& boxes, const node_ind_t index, const node_ind_t end)
 {
-    std::ifstream file(fname);
-    if (file.good())
+    Node& node = this->nodes[index];
+    node.bbox = BoundingBox();
+    if (node.isLeaf())
     {
-        int size;
-        file >> size;
-        this->nodes.resize(size);
-        file >> this->root;
-        for(unsigned int i=0;i<this->nodes.size();++i)
+        for(triangle_ind_t i=node.triangle;i<node.triangle + node.count;++i)
         {
-            file >> this->nodes.at(i).left >> this->nodes.at(i).right;
-            file >> this->nodes.at(i).triangle;
-            file >> this->nodes.at(i).bbox.pmin.x >> this->nodes.at(i).bbox.pmin.y >> this->nodes.at(i).bbox.pmin.z;
-            file >> this->nodes.at(i).bbox.pmax.x >> this->nodes.at(i).bbox.pmax.y >> this->nodes.at(i).bbox.pmax.z;
+            node.bbox.insert(boxes[i]);
         }
-        file.close();
-        return true;
+        return;
     }
-    return false;
+    // Les deux fils sont indépendants : les grands sous-arbres sont réajustés en parallèle.
+    const node_ind_t left = node.left, right = node.right;
+    #pragma omp task shared(boxes) if (end - index > BVH_REFIT_CHUNK)
+    this->refit_node(boxes, left, right);
+    #pragma omp task shared(boxes) if (end - index > BVH_REFIT_CHUNK)
+    this->refit_node(boxes, right, end);
+    #pragma omp taskwait
+    node.bbox.insert(this->nodes[left].bbox);
+    node.bbox.insert(this->nodes[right].bbox);
 }
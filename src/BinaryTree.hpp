@@ -9,30 +9,26 @@
 
 #include <vector>
 #include <cstdint>
-#include <string>
 #include "core/gkit_core.hpp"
-#include "core/ray_core.hpp"
+#include "structures/BoundingBox.hpp"
+#include "structures/Triangle.hpp"
+
+#define BVH_LEAF_SIZE    4   //!< Le nombre maximum de primitives d'une feuille.
+#define BVH_MEDIAN_DEPTH 64  //!< La profondeur à partir de laquelle on coupe à la médiane, pour borner la hauteur.
+#define BVH_STACK_SIZE   128 //!< La taille de la pile de parcours, plus grande que la hauteur maximale.
+#define BVH_SAH_TRAVERSAL 1.0f //!< Le cout de la visite d'un noeud interne dans le SAH, relatif au test d'une primitive.
+#define BVH_REFIT_CHUNK  1024 //!< Le nombre de noeuds en dessous duquel un sous-arbre est réajusté sans nouvelle tache.
 
 typedef uint32_t triangle_ind_t;
 typedef int32_t  node_ind_t;
 
-class BoundingBox final
-{
-    public:
-        vec3 pmin; //!< Le point minimale.
-        vec3 pmax; //!< Le point maximale.
-        
-        /**
-         * @brief Vérifie si @b ray intersecte la boite englobante.
-         * @param[in] ray Le rayon avec lequel tester.
-         * @return true si @b ray intersecte la boite, false sinon.
-         */
-        bool intersect(const Ray& ray) const noexcept;
-};
-
 /**
  * @class BinaryTree
- * @brief Embarque un arbre binaire pour BVHs.
+ * @brief Embarque un arbre binaire pour BVHs, au-dessus de triangles (BLAS) ou d'instances (TLAS).
+ * @details L'arbre ne connait que les boites des primitives : build() donne l'ordre dans lequel
+ * l'appelant doit ranger ses primitives, chaque feuille référençant alors un intervalle contigu.
+ * Les noeuds sont rangés en ordre préfixe : la racine est le premier, et le sous-arbre gauche
+ * d'un noeud interne occupe les indices entre le sien et celui de son fils droit.
  */
 class BinaryTree final
 {
@@ -44,7 +40,7 @@ class BinaryTree final
         class Node final
         {
             public:
-                Node(const node_ind_t r=-1, const node_ind_t l=-1, const triangle_ind_t t=0);
+                Node(const node_ind_t r=-1, const node_ind_t l=-1, const triangle_ind_t t=0, const triangle_ind_t c=0);
                 /**
                  * @brief Indique si un Node est une feuille
                  * @return Vrai si le Node est une feuille, Faux sinon
@@ -54,32 +50,144 @@ class BinaryTree final
                     return right == -1 && left == -1;
                 }
                 /**
-                 * @brief Crée une feuille embarquant le triangle numéro @b triangleOffset.
-                 * @param[in] triangleOffset L'indice du triangle que cette feuille référence.
+                 * @brief Crée une feuille embarquant les primitives [@b triangleOffset, @b triangleOffset + @b count).
+                 * @param[in] triangleOffset L'indice de la première primitive que cette feuille référence.
+                 * @param[in] count          Le nombre de primitives.
                  * @return Le Node nouvellement créé, pour etre copié.
                  */
-                static Node make_leaf(const triangle_ind_t triangleOffset) noexcept;
+                static Node make_leaf(const triangle_ind_t triangleOffset, const triangle_ind_t count) noexcept;
 
                 BoundingBox    bbox;     //!< La boite englobante pour ce noeud.
                 node_ind_t     right;    //!< L'offset du fils droit,  -1 --> feuille.
                 node_ind_t     left;     //!< L'offset du fils gauche, -1 --> feuille.
-                triangle_ind_t triangle; //!< Le triangle concerné dans le tableau. --> Que si Node
+                triangle_ind_t triangle; //!< La première primitive concernée, dans l'ordre donné par build(). --> Que si feuille
+                triangle_ind_t count;    //!< Le nombre de primitives de la feuille.
         };
 
+        BinaryTree(void) : nodes(), root(0), cost(0.0f) {}
+        /**
+         * @brief Construit l'arbre au-dessus des primitives de boites @b boxes.
+         * @param[in]  boxes La boite englobante de chaque primitive.
+         * @param[out] order L'ordre des primitives : la i-ème position des feuilles désigne la primitive order[i].
+         */
+        void build(const std::vector<BoundingBox>& boxes, std::vector<triangle_ind_t>& order);
+        /**
+         * @brief Recalcule les boites des noeuds, des feuilles vers la racine, sans changer l'arbre.
+         * @details Les grands sous-arbres sont réajustés en parallèle, pour un cout linéaire en nombre de noeuds.
+         * @param[in] boxes La nouvelle boite de chaque primitive, dans l'ordre où l'appelant les range.
+         * @pre @b boxes a autant de primitives que lors de la construction.
+         */
+        void refit(const std::vector<BoundingBox>& boxes);
+        /**
+         * @brief Réajuste l'arbre, et le reconstruit si sa qualité s'est trop dégradée.
+         * @param[in]  boxes   La nouvelle boite de chaque primitive, dans l'ordre où l'appelant les range.
+         * @param[out] order   Si l'arbre est reconstruit, la i-ème position des feuilles désigne la primitive
+         *                     rangée jusque là en order[i].
+         * @param[in]  rebuild Le rapport maximal entre le SAH réajusté et celui de la construction.
+         * @return true si l'arbre a été reconstruit, l'appelant devant alors réordonner ses primitives.
+         * @pre @b boxes a autant de primitives que lors de la construction.
+         */
+        bool update(const std::vector<BoundingBox>& boxes, std::vector<triangle_ind_t>& order, const float rebuild);
+        /**
+         * @brief Calcule le cout de l'arbre par la surface area heuristic.
+         * @return La somme, sur les noeuds, de leur cout pondéré par le rapport de leur aire à celle de la racine.
+         */
+        float sah(void) const;
+        //! Renvoie le rapport entre le SAH actuel et celui de la construction, 1 pour un arbre qui vient d'etre construit.
+        float degradation(void) const
+        {
+            return (this->cost > 0.0f) ? this->sah()/this->cost : 1.0f;
+        }
+        /**
+         * @brief Parcourt les feuilles dont la boite est traversée par @b ray, les plus proches d'abord.
+         * @tparam Leaf Appelée en bool(triangle_ind_t first, triangle_ind_t count), renvoie true pour arreter le parcours.
+         * @param[in] ray  Le rayon, dans le repère des boites.
+         * @param[in] tmax L'abscisse maximale, que @b leaf peut réduire au fil du parcours.
+         * @param[in] leaf Le test des primitives d'une feuille.
+         * @return true si @b leaf a arreté le parcours.
+         */
+        template<typename Leaf>
+        bool traverse(const Ray& ray, const float& tmax, Leaf leaf) const
+        {
+            float tnear;
+            const Vector inverse(1.0f/ray.d.x, 1.0f/ray.d.y, 1.0f/ray.d.z);
+            if (this->nodes.empty() || !this->nodes[this->root].bbox.intersect(ray, inverse, tmax, tnear))
+            {
+                return false;
+            }
+            node_ind_t stack[BVH_STACK_SIZE];
+            float      entry[BVH_STACK_SIZE];
+            int        top = 0;
+            stack[top] = this->root;
+            entry[top++] = tnear;
+            while(top > 0)
+            {
+                --top;
+                if (entry[top] > tmax)
+                {
+                    continue;
+                }
+                const Node& node = this->nodes[stack[top]];
+                if (node.isLeaf())
+                {
+                    if (leaf(node.triangle, node.count))
+                    {
+                        return true;
+                    }
+                    continue;
+                }
+                float tleft, tright;
+                const bool left  = this->nodes[node.left].bbox.intersect(ray, inverse, tmax, tleft);
+                const bool right = this->nodes[node.right].bbox.intersect(ray, inverse, tmax, tright);
+                // Le fils le plus proche est empilé en dernier, pour etre visité en premier.
+                if (left && right && tleft < tright)
+                {
+                    stack[top] = node.right;
+                    entry[top++] = tright;
+                    stack[top] = node.left;
+                    entry[top++] = tleft;
+                }
+                else if (left && right)
+                {
+                    stack[top] = node.left;
+                    entry[top++] = tleft;
+                    stack[top] = node.right;
+                    entry[top++] = tright;
+                }
+                else if (left || right)
+                {
+                    stack[top] = left ? node.left : node.right;
+                    entry[top++] = left ? tleft : tright;
+                }
+            }
+            return false;
+        }
+
+        std::vector<BinaryTree::Node> nodes; //!< L'ensemble des éléments de l'arbre.
+        node_ind_t                    root;  //!< Indice du noeud racine
+        float                         cost;  //!< Le SAH à la construction, référence de update().
+
+    private:
+        /**
+         * @brief Construit le sous-arbre des primitives order[begin, end), en réordonnant cet intervalle.
+         * @param[in]     boxes   Les boites des primitives.
+         * @param[in]     centers Les centres des boites.
+         * @param[in,out] order   L'ordre des primitives, partitionné au fil de la construction.
+         * @param[in]     begin   La première position.
+         * @param[in]     end     La position de fin, exclue.
+         * @param[in]     depth   La profondeur du noeud construit.
+         * @return L'indice du noeud construit dans BinaryTree::nodes.
+         */
+        node_ind_t build_node(const std::vector<BoundingBox>& boxes, const std::vector<vec3>& centers,
+                              std::vector<triangle_ind_t>& order, const triangle_ind_t begin, const triangle_ind_t end,
+                              int depth);
         /**
-         * @brief Initialisation de l'arbre en fonction de la scene
+         * @brief Réajuste le sous-arbre de racine @b index, qui occupe les noeuds [@b index, @b end).
+         * @param[in] boxes La boite de chaque primitive.
+         * @param[in] index L'indice de la racine du sous-arbre.
+         * @param[in] end   L'indice suivant le dernier noeud du sous-arbre.
          */
-        void init(const std::string& fname);
-        node_ind_t build_node(const triangle_ind_t begin, const triangle_ind_t end);
-        bool intersect(const Ray& ray, Hit& hit) const;
-        bool fromFile(const std::string& fname);
-        void dump(const std::string& fname);
-        
-        
-        std::vector<Triangle>*        triangles; //!< L'ensemble des triangles dans la structure.
-        std::vector<BinaryTree::Node> nodes;     //!< L'ensemble des éléments de l'arbre.
-        triangle_ind_t                root;      //!< Indice du noeud racine
-    
+        void refit_node(const std::vector<BoundingBox>& boxes, const node_ind_t index, const node_ind_t end);
 };
 
 #endif
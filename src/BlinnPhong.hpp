@@ -8,30 +8,97 @@
 #define BLINNPHONG_HPP_INCLUDED
 
 #include <vector>
+#include <algorithm>
 
 #include "core/gkit_core.hpp"
 #include "core/math_core.hpp"
 #include "core/ray_core.hpp"
+#include "structures/ShadingMaterial.hpp"
 
 /**
- * @struct BlinnPhongWrapper
- * @brief Embarque les arguments pour faire un calcul avec blinn phong.
+ * @struct ShadingContext
+ * @brief Les termes de Blinn-Phong qui ne dépendent que du point d'impact.
+ * @details Construit une fois par pixel, puis réutilisé pour tous les échantillons sur les sources.
  */
-struct BlinnPhongWrapper final
+struct ShadingContext final
 {
-    const Hit*   hit;      //!< Le point d'impact trouvé, P.
-    const Mesh*  mesh;     //!< Le mesh qui contient le triangle concerné.
-    const Point* observer; //!< La position de l'observeur.
-    const Point* src;      //!< La source de lumière avec laquelle tester.
+    Point                  p;        //!< Le point d'impact trouvé, P.
+    Vector                 n;        //!< La normale en P.
+    Vector                 PO;       //!< La direction normalisée de P vers l'observateur.
+    const ShadingMaterial* material; //!< La matière du triangle touché, cf Scene::triangle_material.
+
+    /**
+     * @brief Prépare le contexte d'un point d'impact.
+     * @param[in] observer La position de l'observateur.
+     * @param[in] impact   Le point d'impact du rayon.
+     * @param[in] mat      La matière du triangle touché.
+     */
+    ShadingContext(const Point& observer, const Hit& impact, const ShadingMaterial& mat) noexcept
+        : p(impact.p), n(impact.n), PO(normalize(Vector(impact.p, observer))), material(&mat) {}
 };
 
 /**
- * @brief Applique un éclairage de type Blinn Phong
- * @param[in] wrap L'ensemble des arguments pour effectuer ce calcul.
+ * @enum PhongMode
+ * @brief Les termes de Blinn-Phong réellement utilisés, connus à la compilation.
+ */
+enum PhongMode
+{
+    PHONG_SPECULAR = 0, //!< coef == 0.0, seul le reflet compte.
+    PHONG_MIXED    = 1, //!< 0.0 < coef < 1.0, les deux termes comptent.
+    PHONG_DIFFUSE  = 2  //!< coef == 1.0, seul l'albédo diffus compte.
+};
+
+/**
+ * @brief Déduit le PhongMode correspondant à un coefficient de répartition.
  * @param[in] coef Le coefficient de répartition pour l'albédo.
+ * @return Le mode à utiliser pour instancier BlinnPhong.
+ */
+inline PhongMode phongMode(float coef) noexcept
+{
+    if (coef == 1.0f)
+    {
+        return PHONG_DIFFUSE;
+    }
+    return (coef == 0.0f) ? PHONG_SPECULAR : PHONG_MIXED;
+}
+
+/**
+ * @brief Applique un éclairage de type Blinn Phong, en ne calculant que les termes de @b Mode.
+ * @details La répartition entre albédo et reflet est déjà intégrée à la matière.
+ * @tparam Mode Le mode correspondant au coefficient de répartition, cf phongMode().
+ * @param[in] context Les termes propres au point d'impact.
+ * @param[in] src     Le point de la source de lumière avec lequel tester.
+ * @return La couleur obtenue.
+ */
+template<PhongMode Mode>
+Color BlinnPhong(const ShadingContext& context, const Point& src) noexcept
+{
+    const ShadingMaterial& material = *context.material;
+    Vector PS       = normalize(Vector(context.p, src));
+    float  cosTheta = std::max(0.0f, dot(context.n, PS));
+    Color  result(0.0f, 0.0f, 0.0f, 0.0f);
+    if (Mode != PHONG_DIFFUSE)
+    {
+        Vector H         = normalize(context.PO + PS);
+        float  cosThetaH = std::max(0.0f, dot(context.n, H));
+        float  lobe      = material.fastLobe ? fastPow(cosThetaH, material.ns) : std::pow(cosThetaH, material.ns);
+        result           = material.specular*cosTheta*(material.normalization*lobe);
+    }
+    if (Mode != PHONG_SPECULAR)
+    {
+        result = result + cosTheta*material.diffuse;
+    }
+    return result;
+}
+
+/**
+ * @brief Applique un éclairage de type Blinn Phong
+ * @param[in] context Les termes propres au point d'impact.
+ * @param[in] src     Le point de la source de lumière avec lequel tester.
+ * @param[in] mode    Les termes à calculer, cf phongMode().
  * @return La couleur obtenue.
  */
-Color BlinnPhong(const BlinnPhongWrapper& wrap, float coef) noexcept;
+Color BlinnPhong(const ShadingContext& context, const Point& src, PhongMode mode) noexcept;
 
 
 #endif
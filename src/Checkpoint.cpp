@@ -0,0 +1,293 @@
+/**
+ * @file Checkpoint.cpp
+ */
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+#include "Checkpoint.hpp"
+#include "ConfigLoaders.hpp"
+#include "Scene.hpp"
+
+namespace
+{
+    const char     CHECKPOINT_MAGIC[8] = {'R', 'T', 'C', 'K', 'P', 'T', '\0', '\0'};
+    const uint32_t CHECKPOINT_VERSION  = 2;
+
+    /**
+     * @struct CheckpointHeader
+     * @brief L'entete du journal, suivi des bandes.
+     */
+    struct CheckpointHeader
+    {
+        char     magic[8];    //!< CHECKPOINT_MAGIC.
+        uint32_t version;     //!< CHECKPOINT_VERSION.
+        uint32_t rows;        //!< Le nombre de lignes par bande.
+        uint32_t width;       //!< La largeur de l'image.
+        uint32_t height;      //!< La hauteur de l'image.
+        uint64_t fingerprint; //!< Checkpoint::fingerprint() au moment du rendu.
+    };
+
+    /**
+     * @struct BandHeader
+     * @brief Précède les TileBuffer::bandSize() float de chaque bande dans le journal.
+     */
+    struct BandHeader
+    {
+        uint32_t band;  //!< L'indice de la bande.
+        uint32_t count; //!< Le nombre de lignes qui suivent.
+    };
+
+    /**
+     * @class Fnv
+     * @brief Le hash FNV-1a sur 64 bits, alimenté par morceaux.
+     */
+    class Fnv final
+    {
+        public:
+            Fnv(void) : value(14695981039346656037ULL) {}
+            /**
+             * @brief Ajoute les octets de @b data au hash.
+             * @param[in] data Le début des octets.
+             * @param[in] size Leur nombre.
+             * @return Le hash, pour chainer les appels.
+             */
+            Fnv& add(const void* data, std::size_t size)
+            {
+                const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                for(std::size_t i=0;i<size;++i)
+                {
+                    this->value = (this->value ^ bytes[i])*1099511628211ULL;
+                }
+                return *this;
+            }
+            template<typename T>
+            Fnv& add(const T& pod)
+            {
+                return this->add(&pod, sizeof(T));
+            }
+            Fnv& add(const std::string& text)
+            {
+                return this->add(text.c_str(), text.size() + 1);
+            }
+            /**
+             * @brief Ajoute la taille et la date de modification de @b path.
+             * @param[in] path Le fichier.
+             * @return Le hash, pour chainer les appels.
+             */
+            Fnv& file(const std::string& path)
+            {
+                struct stat info;
+                int64_t size = -1, mtime = -1;
+                if (stat(path.c_str(), &info) == 0)
+                {
+                    size  = info.st_size;
+                    mtime = info.st_mtime;
+                }
+                return this->add(path).add(size).add(mtime);
+            }
+            uint64_t value; //!< Le hash courant.
+    };
+
+    /**
+     * @brief Donne le nombre de lignes de la bande @b band.
+     * @param[in] band   L'indice de la bande.
+     * @param[in] rows   Le nombre de lignes par bande.
+     * @param[in] height La hauteur de l'image.
+     * @return Le nombre de lignes, la dernière bande pouvant etre incomplète.
+     */
+    inline int bandRows(int band, int rows, int height) noexcept
+    {
+        return std::min(rows, height - band*rows);
+    }
+
+    /**
+     * @brief Crée un journal vide à la place de @b filename.
+     * @param[in] filename Le nom du journal.
+     * @param[in] header   L'entete à écrire.
+     * @return Le fichier ouvert en écriture, nullptr en cas d'échec.
+     */
+    std::FILE* create(const std::string& filename, const CheckpointHeader& header)
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (file != nullptr && std::fwrite(&header, sizeof(header), 1, file) != 1)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+        return file;
+    }
+
+    /**
+     * @brief Ajoute une bande au journal.
+     * @param[in] file  Le journal.
+     * @param[in] frame Le tampon source.
+     * @param[in] band  L'indice de la bande.
+     * @param[in] count Son nombre de lignes.
+     * @return true si tout a été écrit.
+     */
+    bool append(std::FILE* file, const TileBuffer& frame, int band, int count)
+    {
+        const BandHeader header = {static_cast<uint32_t>(band), static_cast<uint32_t>(count)};
+        const std::size_t size = frame.bandSize();
+        return std::fwrite(&header, sizeof(header), 1, file) == 1
+            && std::fwrite(frame.band(band), sizeof(float), size, file) == size;
+    }
+}
+
+
+Checkpoint::Checkpoint(const std::string& filename, int rows, float interval, TileBuffer& frame, std::vector<char>& done)
+    : filename(filename), file(nullptr), rows(rows), interval(interval), flushed(std::time(nullptr)), stored(), lock()
+{
+    const int bands = (frame.height + rows - 1)/rows;
+    done.assign(bands, 0);
+    this->stored.assign(bands, 0);
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.version     = CHECKPOINT_VERSION;
+    header.rows        = rows;
+    header.width       = frame.width;
+    header.height      = frame.height;
+    header.fingerprint = Checkpoint::fingerprint();
+
+    // Recharge les bandes complètes d'un journal compatible.
+    int restored = 0;
+    std::FILE* previous = std::fopen(filename.c_str(), "rb");
+    if (previous != nullptr)
+    {
+        CheckpointHeader found;
+        if (std::fread(&found, sizeof(found), 1, previous) == 1 && std::memcmp(&found, &header, sizeof(header)) == 0)
+        {
+            BandHeader band;
+            while(std::fread(&band, sizeof(band), 1, previous) == 1)
+            {
+                if (band.band >= static_cast<uint32_t>(bands)
+                    || band.count != static_cast<uint32_t>(bandRows(band.band, rows, frame.height)))
+                {
+                    break;
+                }
+                const std::size_t size = frame.bandSize();
+                if (std::fread(frame.band(band.band), sizeof(float), size, previous) != size)
+                {
+                    break;
+                }
+                restored += !done[band.band];
+                done[band.band] = 1;
+            }
+        }
+        std::fclose(previous);
+    }
+
+    // Réécrit le journal avec les seules bandes valides, puis le remplace d'un coup.
+    const std::string temporary = filename + ".tmp";
+    this->file = create(temporary, header);
+    for(int band=0;band<bands && this->file != nullptr;++band)
+    {
+        if (done[band] && !append(this->file, frame, band, bandRows(band, rows, frame.height)))
+        {
+            std::fclose(this->file);
+            this->file = nullptr;
+        }
+        this->stored[band] = done[band];
+    }
+    if (this->file != nullptr)
+    {
+        std::fclose(this->file);
+        std::remove(filename.c_str());
+        this->file = (std::rename(temporary.c_str(), filename.c_str()) == 0) ? std::fopen(filename.c_str(), "ab") : nullptr;
+    }
+    if (this->file == nullptr)
+    {
+        std::cerr << "[WARNING]: impossible d'écrire le point de reprise " << filename << std::endl;
+    }
+    if (restored > 0)
+    {
+        std::cout << "Reprise de " << restored << " bandes sur " << bands << " depuis " << filename << std::endl;
+    }
+}
+
+Checkpoint::~Checkpoint(void) noexcept
+{
+    if (this->file != nullptr)
+    {
+        std::fclose(this->file);
+    }
+}
+
+void Checkpoint::save(const TileBuffer& frame, int y0, int y1)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    const int band = y0/this->rows;
+    if (this->file == nullptr || this->stored[band])
+    {
+        return;
+    }
+    this->stored[band] = 1;
+    if (!append(this->file, frame, band, y1 - y0))
+    {
+        std::cerr << "[WARNING]: écriture du point de reprise interrompue" << std::endl;
+        std::fclose(this->file);
+        this->file = nullptr;
+        return;
+    }
+    const std::time_t now = std::time(nullptr);
+    if (std::difftime(now, this->flushed) >= this->interval)
+    {
+        std::fflush(this->file);
+        this->flushed = now;
+    }
+}
+
+void Checkpoint::finish(void)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->file != nullptr)
+    {
+        std::fclose(this->file);
+        this->file = nullptr;
+    }
+    std::remove(this->filename.c_str());
+}
+
+uint64_t Checkpoint::fingerprint(void)
+{
+    Fnv hash;
+    hash.add(RaytracingXml::interpolation).add(RaytracingXml::specularTolerance)
+        .add(RaytracingXml::directEnabled).add(RaytracingXml::indirectEnabled).add(RaytracingXml::emitedEnabled)
+        .add(RaytracingXml::visibilityCache);
+    if (RaytracingXml::visibilityCache)
+    {
+        // Le cache réutilise une visibilité échantillonnée par cellule : une autre taille change l'image.
+        hash.add(RaytracingXml::visibilityCell);
+    }
+    if (RaytracingXml::directEnabled)
+    {
+        hash.add(RaytracingXml::directN).add(RaytracingXml::directMethod).add(RaytracingXml::normalTweak)
+            .add(RaytracingXml::irradianceError).add(RaytracingXml::irradianceMinRadius)
+            .add(RaytracingXml::irradianceMaxRadius).add(RaytracingXml::irradianceSpecularN);
+    }
+    if (RaytracingXml::indirectEnabled)
+    {
+        hash.add(RaytracingXml::indirectN).add(RaytracingXml::indirectMethod)
+            .add(RaytracingXml::photonCount).add(RaytracingXml::photonRadius);
+    }
+    hash.add(ImageXml::width).add(ImageXml::height).add(ImageXml::fov);
+    hash.file(SceneXml::obj).file(SceneXml::orbiter);
+    if (SceneXml::turntableFrames > 0)
+    {
+        hash.add(SceneXml::turntableFrames).add(SceneXml::turntableDegrees).add(SceneXml::frame);
+    }
+    for(const ShadingMaterial& material : Scene::materials)
+    {
+        hash.add(material);
+    }
+    for(const InstanceXml& instance : SceneXml::instances)
+    {
+        hash.file(instance.obj).add(instance.translate).add(instance.rotate).add(instance.scale);
+    }
+    hash.add(Scene::triangles.size()).add(Scene::sources.size());
+    return hash.value;
+}
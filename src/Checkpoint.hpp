@@ -0,0 +1,79 @@
+/**
+ * @file Checkpoint.hpp
+ * @brief Sauvegarde les bandes terminées d'un rendu, pour reprendre après une interruption.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef CHECKPOINT_HPP_INCLUDED
+#define CHECKPOINT_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "structures/TileBuffer.hpp"
+
+
+/**
+ * @class Checkpoint
+ * @brief Un journal des bandes de lignes terminées, en luminance linéaire.
+ * @details Les bandes sont écrites telles que rangées dans le TileBuffer, en tuiles RGB. Le fichier commence par une empreinte de la configuration et de la scène.
+ * Chaque bande terminée y est ajoutée à la suite. Une bande tronquée par un arret brutal
+ * est simplement ignorée à la reprise.
+ */
+class Checkpoint final
+{
+    public:
+        /**
+         * @brief Ouvre le journal et recharge les bandes d'un rendu précédent identique.
+         * @param[in]     filename Le nom du journal.
+         * @param[in]     rows     Le nombre de lignes par bande, RENDER_BAND_ROWS.
+         * @param[in]     interval Le nombre de secondes minimum entre deux écritures sur disque.
+         * @param[in,out] frame    Le tampon à remplir avec les bandes rechargées.
+         * @param[out]    done     Pour chaque bande, 1 si elle a été rechargée, 0 sinon.
+         * @pre La configuration et la scène doivent etre chargées (cf fingerprint).
+         */
+        Checkpoint(const std::string& filename, int rows, float interval, TileBuffer& frame, std::vector<char>& done);
+        /**
+         * @brief Ferme le journal, qui reste sur le disque.
+         */
+        ~Checkpoint(void) noexcept;
+        /**
+         * @brief Ajoute les lignes [y0, y1) au journal si elles n'y sont pas déjà.
+         * @param[in] frame Le tampon, qui contient ces lignes.
+         * @param[in] y0    La première ligne de la bande.
+         * @param[in] y1    La ligne suivant la dernière de la bande.
+         * @note Peut etre appelée depuis plusieurs threads à la fois.
+         */
+        void save(const TileBuffer& frame, int y0, int y1);
+        /**
+         * @brief Supprime le journal, une fois le rendu et ses sorties écrits.
+         */
+        void finish(void);
+        /**
+         * @brief Calcule l'empreinte de tout ce qui influe sur les pixels.
+         * @details Les options de rendu et d'image, la taille et la date des fichiers de la scène,
+         * ainsi que les matières chargées. La graine aléatoire et les options de sortie n'en font pas partie.
+         * @return L'empreinte.
+         */
+        static uint64_t fingerprint(void);
+
+        Checkpoint(void)                                  = delete;
+        Checkpoint(const Checkpoint& other)               = delete;
+        Checkpoint& operator=(const Checkpoint& other)    = delete;
+
+    private:
+        std::string       filename; //!< Le nom du journal.
+        std::FILE*        file;     //!< Le journal ouvert en ajout.
+        int               rows;     //!< Le nombre de lignes par bande.
+        double            interval; //!< Le délai entre deux fflush, en secondes.
+        std::time_t       flushed;  //!< La date du dernier fflush.
+        std::vector<char> stored;   //!< Les bandes déjà présentes dans le journal.
+        std::mutex        lock;     //!< Protège l'écriture du journal.
+};
+
+
+#endif
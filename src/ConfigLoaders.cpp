@@ -1,23 +1,48 @@
 /**
  * @file ConfigLoaders.cpp
  */
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <ctime>
+#ifndef _WIN32
+    #include <glob.h>
+#endif
 
 #include "ConfigLoaders.hpp"
+#include "Framebuffer.hpp"
 #include "XmlLoader.hpp"
 
 
 std::string ImageXml::outputName;
+std::string ImageXml::outputBase;
+bool        ImageXml::writePng;
+bool        ImageXml::writeHdr;
+bool        ImageXml::writePfm;
+bool        ImageXml::overlap;
 int         ImageXml::width;
 int         ImageXml::height;
 float       ImageXml::fov;
+std::string ImageXml::tonemap;
+float       ImageXml::gamma;
+bool        ImageXml::denoise;
+int         ImageXml::denoiseIterations;
+float       ImageXml::denoiseColor;
+float       ImageXml::denoiseAlbedo;
+float       ImageXml::denoiseNormal;
+float       ImageXml::denoiseDepth;
+unsigned    ImageXml::aovs;
 
 std::string SceneXml::obj;
 std::string SceneXml::orbiter;
+std::vector<std::string> SceneXml::orbiters;
+int         SceneXml::turntableFrames;
+float       SceneXml::turntableDegrees;
+int         SceneXml::frame;
+std::vector<InstanceXml> SceneXml::instances;
 
 float       RaytracingXml::interpolation;
+float       RaytracingXml::specularTolerance;
 int         RaytracingXml::seed;
 bool        RaytracingXml::directEnabled;
 bool        RaytracingXml::indirectEnabled;
@@ -27,6 +52,20 @@ int         RaytracingXml::indirectN;
 std::string RaytracingXml::directMethod;
 std::string RaytracingXml::indirectMethod;
 float       RaytracingXml::normalTweak;
+bool        RaytracingXml::checkpointEnabled;
+float       RaytracingXml::checkpointInterval;
+int         RaytracingXml::workers;
+float       RaytracingXml::workerTimeout;
+int         RaytracingXml::serverMemory;
+bool        RaytracingXml::visibilityCache;
+float       RaytracingXml::visibilityCell;
+float       RaytracingXml::irradianceError;
+float       RaytracingXml::irradianceMinRadius;
+float       RaytracingXml::irradianceMaxRadius;
+int         RaytracingXml::irradianceSpecularN;
+int         RaytracingXml::photonCount;
+float       RaytracingXml::photonRadius;
+float       RaytracingXml::bvhRebuild;
 
 
 namespace
@@ -48,6 +87,7 @@ namespace
             RaytracingXml::seed = file.text<int>();
         }
         RaytracingXml::interpolation = file.element("phongInterpolation").text<float>();
+        RaytracingXml::specularTolerance = file.element("specularTolerance").text<float>();
         RaytracingXml::directEnabled = file.node("direct").attribute<bool>("enable");
         if (RaytracingXml::directEnabled)
         {
@@ -62,6 +102,61 @@ namespace
             RaytracingXml::indirectMethod = file.element("enumMethod").text<std::string>();
         }
         RaytracingXml::emitedEnabled = file.prev().element("emited").attribute<bool>("enable");
+        RaytracingXml::checkpointEnabled  = file.element("checkpoint").attribute<bool>("enable");
+        RaytracingXml::checkpointInterval = file.attribute<float>("interval");
+        RaytracingXml::workers       = file.element("distributed").attribute<int>("workers");
+        RaytracingXml::workerTimeout = file.attribute<float>("timeout");
+        RaytracingXml::serverMemory = file.element("server").attribute<int>("memory");
+        RaytracingXml::visibilityCache = file.element("visibilityCache").attribute<bool>("enable");
+        RaytracingXml::visibilityCell  = file.attribute<float>("cell");
+        RaytracingXml::irradianceError     = file.element("irradianceCache").attribute<float>("error");
+        RaytracingXml::irradianceMinRadius = file.attribute<float>("minRadius");
+        RaytracingXml::irradianceMaxRadius = file.attribute<float>("maxRadius");
+        RaytracingXml::irradianceSpecularN = file.attribute<int>("specularN");
+        RaytracingXml::photonCount  = file.element("photonMap").attribute<int>("photons");
+        RaytracingXml::photonRadius = file.attribute<float>("radius");
+        RaytracingXml::bvhRebuild   = file.element("bvh").attribute<float>("rebuild");
+    }
+    
+    /**
+     * @brief Ajoute les orbiters désignés par @b pattern, un chemin ou un motif du shell.
+     * @param[in]     pattern  Le texte d'un élément orbiter.
+     * @param[in,out] orbiters La liste à compléter, dans l'ordre alphabétique pour un motif.
+     */
+    void expandOrbiters(const std::string& pattern, std::vector<std::string>& orbiters)
+    {
+#ifndef _WIN32
+        glob_t found;
+        if (pattern.find_first_of("*?[") != std::string::npos && glob(pattern.c_str(), 0, nullptr, &found) == 0)
+        {
+            orbiters.insert(orbiters.end(), found.gl_pathv, found.gl_pathv + found.gl_pathc);
+            globfree(&found);
+            return;
+        }
+#endif
+        orbiters.push_back(pattern);
+    }
+    
+    /**
+     * @brief Lit un attribut de 3 flottants séparés par des espaces, comme "0 1.5 0".
+     * @param[in,out] file   Le fichier, sur l'élément à lire.
+     * @param[in]     name   Le nom de l'attribut.
+     * @param[out]    values Les 3 valeurs, @b fallback pour celles qui manquent.
+     * @param[in]     fallback La valeur par défaut.
+     * @note Une seule valeur est répétée sur les 3 axes, pour une échelle uniforme.
+     */
+    void readTriple(XmlLoader& file, const std::string& name, float values[3], float fallback)
+    {
+        std::istringstream stream(file.attribute<std::string>(name));
+        int count = 0;
+        while(count < 3 && stream >> values[count])
+        {
+            ++count;
+        }
+        for(int i=count;i<3;++i)
+        {
+            values[i] = (count == 1) ? values[0] : fallback;
+        }
     }
     
     /**
@@ -72,8 +167,27 @@ namespace
     void loadScene(void)
     {
         XmlLoader file("data/xml/scene.xml");
-        SceneXml::obj     = file.element("obj").text<std::string>();
-        SceneXml::orbiter = file.element("orbiter").text<std::string>();
+        SceneXml::obj = file.element("obj").text<std::string>();
+        SceneXml::orbiters.clear();
+        file.forEachElementNamed("orbiter", [&file](void){
+            expandOrbiters(file.text<std::string>(), SceneXml::orbiters);
+        });
+        SceneXml::orbiter = SceneXml::orbiters.empty() ? std::string() : SceneXml::orbiters.front();
+        SceneXml::turntableFrames  = file.element("turntable").attribute<int>("frames");
+        SceneXml::turntableDegrees = file.attribute<float>("degrees");
+        SceneXml::frame            = 0;
+        SceneXml::instances.clear();
+        if (file.hasElement("instance"))
+        {
+            file.forEachElementNamed("instance", [&file](void){
+                InstanceXml instance;
+                instance.obj = file.attribute<std::string>("obj");
+                readTriple(file, "translate", instance.translate, 0.0f);
+                readTriple(file, "rotate",    instance.rotate,    0.0f);
+                readTriple(file, "scale",     instance.scale,     1.0f);
+                SceneXml::instances.push_back(instance);
+            });
+        }
     }
     
     /**
@@ -86,6 +200,10 @@ namespace
         std::string obj     = SceneXml::obj.substr(SceneXml::obj.rfind('/')+1, SceneXml::obj.rfind(".obj")-5);
         std::string orbiter = SceneXml::orbiter.substr(SceneXml::orbiter.rfind('/')+1, SceneXml::orbiter.rfind(".txt"));
         stream << obj << '_' << orbiter << '_';
+        if (SceneXml::turntableFrames > 0)
+        {
+            stream << 'f' << std::setw(3) << std::setfill('0') << SceneXml::frame << '_';
+        }
         if (RaytracingXml::emitedEnabled)
         {
             stream << "L0";
@@ -112,13 +230,28 @@ namespace
         ImageXml::fov        = file.element("fov").text<float>();
         ImageXml::width      = file.element("width").text<int>();
         ImageXml::height     = file.element("height").text<int>();
-        std::string basename = file.element("output").text<std::string>();
-        std::stringstream fullname;
-        fullname << basename;
-        buildFullname(fullname);
-        
-        // Gaffe au move ici.
-        ImageXml::outputName = std::move(fullname.str());
+        ImageXml::gamma      = file.element("tonemap").attribute<float>("gamma");
+        ImageXml::tonemap    = file.text<std::string>();
+        ImageXml::outputBase = file.element("output").text<std::string>();
+        ImageXml::writePng   = file.attribute<bool>("png");
+        ImageXml::writeHdr   = file.attribute<bool>("hdr");
+        ImageXml::writePfm   = file.attribute<bool>("pfm");
+        ImageXml::overlap    = file.attribute<bool>("overlap");
+        ImageXml::denoise           = file.element("denoise").attribute<bool>("enable");
+        ImageXml::denoiseIterations = file.attribute<int>("iterations");
+        ImageXml::denoiseColor      = file.attribute<float>("color");
+        ImageXml::denoiseAlbedo     = file.attribute<float>("albedo");
+        ImageXml::denoiseNormal     = file.attribute<float>("normal");
+        ImageXml::denoiseDepth      = file.attribute<float>("depth");
+        ImageXml::aovs              = 0;
+        file.element("aovs");
+        for(int channel=AOV_BEAUTY;channel<AOV_COUNT;++channel)
+        {
+            if (file.attribute<bool>(Framebuffer::name(static_cast<AovChannel>(channel))))
+            {
+                ImageXml::aovs |= 1u << channel;
+            }
+        }
     }
     
 }
@@ -131,5 +264,15 @@ void ConfigLoaders::loadXMLs(void)
     loadRaytracing();
     loadScene();
     loadImage();
+    ConfigLoaders::buildOutputName();
+}
+
+void ConfigLoaders::buildOutputName(void)
+{
+    std::stringstream fullname;
+    fullname << ImageXml::outputBase;
+    buildFullname(fullname);
     
+    // Gaffe au move ici.
+    ImageXml::outputName = std::move(fullname.str());
 }
@@ -11,6 +11,7 @@
 #define CONFIGLOADERS_HPP_INCLUDED
 
 #include <string>
+#include <vector>
 
 
 /**
@@ -21,14 +22,40 @@ class ImageXml final
 {
     public:
         static std::string outputName; //!< Le nom complet de sauvegarde du résultat.
+        static std::string outputBase; //!< Le début du nom de sauvegarde, tel que lu dans image.xml.
+        static bool        writePng;   //!< Si on écrit l'image tonemappée en .png.
+        static bool        writeHdr;   //!< Si on écrit la luminance linéaire en .hdr (RGBE).
+        static bool        writePfm;   //!< Si on écrit la luminance linéaire en .pfm (float).
+        static bool        overlap;    //!< Si l'écriture d'une image se fait pendant le rendu de la suivante.
         static int         width;      //!< La longueur de l'image résultat.
         static int         height;     //!< La largeur de l'image résultat.
         static float       fov;        //!< L'ouverture de la focale.
+        static std::string tonemap;    //!< Le nom de l'opérateur de tonemapping, cf TonemapFactory.
+        static float       gamma;      //!< Le gamma de l'écran.
+        static bool        denoise;           //!< Si on débruite l'image avant de l'écrire, cf Denoiser.
+        static int         denoiseIterations; //!< Le nombre d'itérations du filtre à trous.
+        static float       denoiseColor;      //!< L'écart de couleur toléré, relatif à la luminance.
+        static float       denoiseAlbedo;     //!< L'écart d'albédo toléré.
+        static float       denoiseNormal;     //!< L'écart de normale toléré, sur 1 - cos.
+        static float       denoiseDepth;      //!< L'écart de profondeur toléré, relatif et par pixel.
+        static unsigned    aovs;              //!< Un bit par AovChannel à écrire en .pfm, cf Framebuffer.
         
         ImageXml(void) = delete;
     
 };
 
+/**
+ * @struct InstanceXml
+ * @brief Une copie d'un .obj placée dans la scène, cf Instancing.
+ */
+struct InstanceXml
+{
+    std::string obj;          //!< Le .obj instancié, chargé une seule fois quel que soit le nombre de copies.
+    float       translate[3]; //!< La translation.
+    float       rotate[3];    //!< Les rotations autour de x, puis de y, puis de z, en degrés.
+    float       scale[3];     //!< L'échelle sur chaque axe.
+};
+
 /**
  * @class SceneXml
  * @brief Porte le contenu du fichier scene.xml
@@ -38,6 +65,11 @@ class SceneXml final
     public:
         static std::string obj;     //!< Le nom de l'obj que l'on va raytracer.
         static std::string orbiter; //!< Le nom de l'orbiter que l'on veut charger.
+        static std::vector<std::string> orbiters; //!< Tous les orbiters à rendre à la suite, orbiter étant le courant.
+        static int         turntableFrames;  //!< Le nombre d'images du tour de chaque orbiter, 0 pour une seule vue.
+        static float       turntableDegrees; //!< L'angle parcouru par la caméra sur tout le tour.
+        static int         frame;            //!< L'image en cours du tour, dans [0, turntableFrames).
+        static std::vector<InstanceXml> instances; //!< Les copies de meshes ajoutées à la scène de obj.
         
         SceneXml(void) = delete;
     
@@ -51,6 +83,7 @@ class RaytracingXml final
 {
     public:
         static float       interpolation;   //!< Le coefficient pour l'interpolation de Blinn-Phong.
+        static float       specularTolerance; //!< L'erreur relative acceptée sur le reflet de Blinn-Phong (0 : exact).
         static int         seed;            //!< La graine pour l'utilisation des randoms.
         static bool        directEnabled;   //!< Pour savoir si on veut faire la luminosité directe.
         static bool        indirectEnabled; //!< Pour savoir si on veut faire la luminosité indirecte.
@@ -60,6 +93,20 @@ class RaytracingXml final
         static std::string directMethod;    //!< Le type de méthode directe.
         static std::string indirectMethod;  //!< Le type de méthode indirecte.
         static float       normalTweak;     //!< Le décalage par rapport à la normale.
+        static bool        checkpointEnabled;  //!< Pour savoir si on sauvegarde les bandes terminées pour une reprise.
+        static float       checkpointInterval; //!< Le délai minimum entre deux écritures du point de reprise, en secondes.
+        static int         workers;            //!< Le nombre de processus workers, 0 pour rendre dans ce seul processus.
+        static float       workerTimeout;      //!< Le délai, en secondes, au-delà duquel un worker muet est abandonné.
+        static int         serverMemory;       //!< La mémoire, en Mo, des scènes gardées par le serveur de rendu.
+        static bool        visibilityCache;    //!< Pour savoir si on réutilise la visibilité des sources d'une image à l'autre.
+        static float       visibilityCell;     //!< La taille des cellules du cache de visibilité, relative à la diagonale de la scène.
+        static float       irradianceError;     //!< L'erreur tolérée par l'interpolation de l'IrradianceCache.
+        static float       irradianceMinRadius; //!< Le rayon minimum d'un record, relatif à la diagonale de la scène.
+        static float       irradianceMaxRadius; //!< Le rayon maximum d'un record, relatif à la diagonale de la scène.
+        static int         irradianceSpecularN; //!< Le N du reflet, évalué sans rayon d'ombre, hors des records.
+        static int         photonCount;   //!< Le nombre de photons émis par les sources pour PhotonMap.
+        static float       photonRadius;  //!< Le rayon maximum d'une estimation de densité, relatif à la diagonale de la scène.
+        static float       bvhRebuild;    //!< Le rapport de SAH au-delà duquel un BVH réajusté est reconstruit.
         
         RaytracingXml(void) = delete;
     
@@ -78,6 +125,11 @@ class ConfigLoaders final
          * @throw std::string            Si le parsing de l'XML a échoué.
          */
         static void loadXMLs(void);
+        /**
+         * @brief Reconstruit ImageXml::outputName depuis ImageXml::outputBase et les options courantes.
+         * @pre Tout doit etre chargé au préalable.
+         */
+        static void buildOutputName(void);
         
         ConfigLoaders(void) = delete;
     
@@ -0,0 +1,181 @@
+/**
+ * @file Denoiser.cpp
+ */
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Denoiser.hpp"
+#include "ConfigLoaders.hpp"
+#include "Framebuffer.hpp"
+
+namespace
+{
+    /**
+     * @brief Les coefficients du noyau B3-spline, appliqué en x puis en y.
+     */
+    const float B3_SPLINE[5] = {1.0f/16.0f, 1.0f/4.0f, 3.0f/8.0f, 1.0f/4.0f, 1.0f/16.0f};
+
+    /**
+     * @struct Tolerances
+     * @brief Les inverses des écarts tolérés pour une itération, pour multiplier plutot que diviser.
+     */
+    struct Tolerances
+    {
+        float color;  //!< Sur la couleur, relative à la luminance du pixel filtré.
+        float albedo; //!< Sur l'albédo.
+        float normal; //!< Sur 1 - cos de l'angle entre les normales.
+        float depth;  //!< Sur la profondeur, relative à celle du pixel filtré et à la distance en pixels.
+    };
+
+    /**
+     * @struct Guides
+     * @brief Les plans des AOV qui guident le filtre, lus dans le Framebuffer.
+     * @details Un pixel sans impact a une profondeur nulle.
+     */
+    struct Guides
+    {
+        int          width;    //!< La largeur de l'image.
+        int          height;   //!< La hauteur de l'image.
+        std::size_t  size;     //!< Le nombre de pixels, soit la taille d'un plan.
+        const float* albedo;   //!< AOV_ALBEDO, en 3 plans r, g, b.
+        const float* normal;   //!< AOV_NORMAL, en 3 plans x, y, z.
+        const float* depth;    //!< AOV_DEPTH.
+        const float* emission; //!< AOV_EMITTED, nullptr si elle n'est pas rendue.
+    };
+
+    /**
+     * @brief Applique une itération du filtre à trous sur toute l'image.
+     * @param[in]  in     Les 3 plans de la luminance divisée par l'albédo.
+     * @param[out] out    Les 3 plans filtrés.
+     * @param[in]  guides Les buffers auxiliaires.
+     * @param[in]  step   L'écart en pixels entre deux coefficients du noyau.
+     * @param[in]  tol    Les écarts tolérés pour cette itération.
+     */
+    void atrous(const float* in, float* out, const Guides& guides, int step, const Tolerances& tol)
+    {
+        const int w = guides.width, h = guides.height;
+        const std::size_t size = guides.size;
+        const float* albedo = guides.albedo;
+        const float* normal = guides.normal;
+        const float* depth  = guides.depth;
+        #pragma omp parallel for schedule(static)
+        for(int y=0;y<h;++y)
+        {
+            int rows[5];
+            for(int k=0;k<5;++k)
+            {
+                rows[k] = std::min(std::max(y + (k - 2)*step, 0), h - 1)*w;
+            }
+            for(int x=0;x<w;++x)
+            {
+                const std::size_t i = static_cast<std::size_t>(y)*w + x;
+                const float ci[3] = {in[i], in[size + i], in[2*size + i]};
+                if (depth[i] <= 0.0f)
+                {
+                    out[i] = ci[0];
+                    out[size + i] = ci[1];
+                    out[2*size + i] = ci[2];
+                    continue;
+                }
+                const float luminance = (ci[0] + ci[1] + ci[2])/3.0f;
+                const float color = tol.color/(luminance*luminance + 1e-6f);
+                const float depthScale = tol.depth/(depth[i]*step);
+                float sum[3] = {0.0f, 0.0f, 0.0f};
+                float weights = 0.0f;
+                for(int ky=0;ky<5;++ky)
+                {
+                    for(int kx=0;kx<5;++kx)
+                    {
+                        const std::size_t j = rows[ky] + std::min(std::max(x + (kx - 2)*step, 0), w - 1);
+                        const float dc0 = in[j] - ci[0], dc1 = in[size + j] - ci[1], dc2 = in[2*size + j] - ci[2];
+                        const float da0 = albedo[j] - albedo[i], da1 = albedo[size + j] - albedo[size + i],
+                                    da2 = albedo[2*size + j] - albedo[2*size + i];
+                        const float cosine = normal[i]*normal[j] + normal[size + i]*normal[size + j]
+                                           + normal[2*size + i]*normal[2*size + j];
+                        const float pixels = static_cast<float>(std::abs(kx - 2) + std::abs(ky - 2));
+                        const float error = (dc0*dc0 + dc1*dc1 + dc2*dc2)*color
+                                          + (da0*da0 + da1*da1 + da2*da2)*tol.albedo
+                                          + std::max(0.0f, 1.0f - cosine)*tol.normal
+                                          + std::abs(depth[j] - depth[i])*depthScale/std::max(pixels, 1.0f);
+                        // Un voisin sans impact ne compte pas.
+                        const float weight = B3_SPLINE[kx]*B3_SPLINE[ky]*std::exp(-error)*(depth[j] > 0.0f);
+                        sum[0] += weight*in[j];
+                        sum[1] += weight*in[size + j];
+                        sum[2] += weight*in[2*size + j];
+                        weights += weight;
+                    }
+                }
+                // Le pixel lui-meme a toujours un poids non nul.
+                out[i] = sum[0]/weights;
+                out[size + i] = sum[1]/weights;
+                out[2*size + i] = sum[2]/weights;
+            }
+        }
+    }
+}
+
+
+unsigned Denoiser::guides(void) noexcept
+{
+    const unsigned mask = (1u << AOV_ALBEDO) | (1u << AOV_NORMAL) | (1u << AOV_DEPTH);
+    return RaytracingXml::emitedEnabled ? (mask | (1u << AOV_EMITTED)) : mask;
+}
+
+void Denoiser::filter(Image& image, const Framebuffer& framebuffer)
+{
+    if (image.size() == 0)
+    {
+        return;
+    }
+    Guides guides;
+    guides.width    = image.width();
+    guides.height   = image.height();
+    guides.size     = static_cast<std::size_t>(image.width())*image.height();
+    guides.albedo   = framebuffer.plane(AOV_ALBEDO);
+    guides.normal   = framebuffer.plane(AOV_NORMAL);
+    guides.depth    = framebuffer.plane(AOV_DEPTH);
+    guides.emission = framebuffer.plane(AOV_EMITTED);
+    const std::size_t size = guides.size;
+    const bool emitted = guides.emission != nullptr;
+    std::vector<float> current(3*size), next(3*size);
+    Color* pixels = &image(0, 0);
+
+    // Seul l'éclairage est filtré : sans la luminosité émise, et divisé par l'albédo.
+    #pragma omp parallel for schedule(static)
+    for(std::size_t i=0;i<size;++i)
+    {
+        const float value[3] = {pixels[i].r, pixels[i].g, pixels[i].b};
+        for(int k=0;k<3;++k)
+        {
+            const float emission = emitted ? guides.emission[k*size + i] : 0.0f;
+            current[k*size + i] = (value[k] - emission)/std::max(guides.albedo[k*size + i], DENOISER_MIN_ALBEDO);
+        }
+    }
+    Tolerances tol;
+    tol.albedo = 1.0f/(ImageXml::denoiseAlbedo*ImageXml::denoiseAlbedo);
+    tol.normal = 1.0f/ImageXml::denoiseNormal;
+    tol.depth  = 1.0f/ImageXml::denoiseDepth;
+    for(int iteration=0;iteration<ImageXml::denoiseIterations;++iteration)
+    {
+        const float sigma = ImageXml::denoiseColor/static_cast<float>(1 << iteration);
+        tol.color = 1.0f/(sigma*sigma);
+        atrous(current.data(), next.data(), guides, 1 << iteration, tol);
+        current.swap(next);
+    }
+    #pragma omp parallel for schedule(static)
+    for(std::size_t i=0;i<size;++i)
+    {
+        if (guides.depth[i] <= 0.0f)
+        {
+            continue;
+        }
+        float value[3];
+        for(int k=0;k<3;++k)
+        {
+            const float emission = emitted ? guides.emission[k*size + i] : 0.0f;
+            value[k] = current[k*size + i]*std::max(guides.albedo[k*size + i], DENOISER_MIN_ALBEDO) + emission;
+        }
+        pixels[i] = Color(value[0], value[1], value[2], pixels[i].a);
+    }
+}
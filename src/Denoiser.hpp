@@ -0,0 +1,47 @@
+/**
+ * @file Denoiser.hpp
+ * @brief Le débruitage d'un rendu à faible N, guidé par l'albédo, la normale et la profondeur.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef DENOISER_HPP_INCLUDED
+#define DENOISER_HPP_INCLUDED
+
+#include "core/gkit_core.hpp"
+#include "Framebuffer.hpp"
+
+/**
+ * @brief Le plus petit albédo par lequel on divise la luminance avant de la filtrer.
+ */
+#define DENOISER_MIN_ALBEDO 1e-3f
+
+/**
+ * @class Denoiser
+ * @brief Un filtre en ondelettes à trous (Dammertz et al. 2010), arreté par les bords des buffers auxiliaires.
+ * @details La luminosité émise est retirée, puis la luminance est divisée par l'albédo, pour ne filtrer
+ * que l'éclairage : les textures et les couleurs des matières restent nettes. Chaque itération applique
+ * le noyau B3-spline 5x5 avec un pas doublé, le poids de chaque voisin étant réduit par les écarts
+ * de couleur, d'albédo, de normale et de profondeur. L'écart de couleur toléré est divisé par deux
+ * à chaque itération, comme dans l'article.
+ * Les buffers auxiliaires sont des AOV du Framebuffer, remplies par le noyau de rendu lui-meme.
+ */
+class Denoiser final
+{
+    public:
+        /**
+         * @brief Donne les AOV qui guident le débruitage : albédo, normale, profondeur, et luminosité émise si elle est rendue.
+         * @return Un bit par AovChannel, à remplir par le Framebuffer du rendu.
+         */
+        static unsigned guides(void) noexcept;
+        /**
+         * @brief Débruite @b image, en luminance linéaire, avec les réglages de ImageXml.
+         * @param[in,out] image       L'image rendue.
+         * @param[in]     framebuffer Le Framebuffer de la meme image, avec au moins les AOV de guides().
+         */
+        static void filter(Image& image, const Framebuffer& framebuffer);
+
+        Denoiser(void) = delete;
+};
+
+
+#endif
@@ -2,17 +2,18 @@
  * @file Direct.cpp
  */
 #include <algorithm>
-#include <functional>
 #include <random>
 #include <array>
+#include <cfloat>
 
 #include "Direct.hpp"
 #include "BlinnPhong.hpp"
 #include "ConfigLoaders.hpp"
+#include "IrradianceCache.hpp"
+#include "VisibilityCache.hpp"
 #include "core/math_core.hpp"
 #include "core/gkit_core.hpp"
 #include "structures/World.hpp"
-#include "pdf.hpp"
 
 namespace
 {
@@ -88,8 +89,8 @@ namespace
     }
     /**
      * @brief Applique la formule de l'éclairage directe.
-     * @param[in]  impact    Le hit du point vu par l'observateur.
-     * @param[in]  observer  La position de l'observeur.
+     * @tparam Mode Les termes de Blinn-Phong à évaluer.
+     * @param[in]  context   Les termes propres au point vu par l'observateur.
      * @param[in]  o         Le point d'origine du rayon allant vers la source.
      * @param[in]  e         Le point sur la source pour le rayon.
      * @param[in]  normal    La normal à la source.
@@ -97,60 +98,45 @@ namespace
      * @param[out] cosThetaP Récupère ce cosTheta pour la suite.
      * @return La couleur calculé pour cette étape.
      */
-    Color computeL1(const Hit& impact, const Point& observer, const Point& o, const Point& e,
-                    const Vector& normal, FromG_t& fromG, float& cosThetaP) noexcept
+    template<PhongMode Mode>
+    Color computeL1(const ShadingContext& context, const Point& o, const Point& e, const Vector& normal,
+                    FromG_t& fromG, float& cosThetaP) noexcept
     {
-        BlinnPhongWrapper wrap = {&impact, &Scene::mesh, &observer, &e};
-        Color brdf             = BlinnPhong(wrap, RaytracingXml::interpolation);
-        cosThetaP              = std::cos(dot(normalize(Vector(o, e)), normalize(normal)));
-        fromG                  = computeG(o, impact.n, e, normal, cosThetaP);
+        Color brdf = BlinnPhong<Mode>(context, e);
+        cosThetaP  = std::cos(dot(normalize(Vector(o, e)), normalize(normal)));
+        fromG      = computeG(o, context.n, e, normal, cosThetaP);
         return fromG.at(0)*brdf*cosThetaP;
     }
 
     /**
-     * @brief Effectue un calcul de luminosité directe "générique".
-     * @param[in] observer     La position de l'observateur.
-     * @param[in] impact       Le point d'impact du rayon.
-     * @param[in] N            Le nombre de points/d'itérations voulu(e)s.
-     * @param[in] randFunction La fonction générant les points à la surface des sources.
-     * @param[in] useDistance  Si on veut appliquer G(p,s) sur chaque couleur ajoutée.
-     * @return La couleur obtenue.
+     * @brief Remplit @b batch avec N points par source, tirés par @b randFunction.
+     * @tparam RandFunction Un appelable Point(Source&, Vector& n).
+     * @param[in]  o            Le point d'impact, décalé selon sa normale.
+     * @param[in]  N            Le nombre de points voulus sur chaque source.
+     * @param[in]  randFunction La fonction générant les points à la surface des sources.
+     * @param[out] batch        Le tampon à remplir.
      */
-    Color basicDirect(const Point& observer, const Hit& impact, int N, std::function<Point(Source&, Vector& n)> randFunction)
+    template<typename RandFunction>
+    void basicDirect(const Point& o, int N, RandFunction randFunction, ShadowBatch& batch)
     {
-        Color result;
-        Hit hit;
-        Point o = shift(impact.p, impact.n);
         std::for_each(Scene::sources.begin(), Scene::sources.end(), [&](Source& src){
             for(int i=0;i<N;++i)
             {
                 Vector normal;
                 Point e = randFunction(src, normal);
-                Ray ray(o, e);
-                if (!Scene::intersect(ray, hit))
-                {
-                    FromG_t foo1;
-                    float foo2;
-                    result = result + computeL1(impact, observer, o, e, normal, foo1, foo2);
-                }
+                batch.push(Ray(o, e), e, normal);
             }
         });
-        return result/static_cast<float>(Scene::sources.size()*N);
     }
     /**
-     * @brief Méthode directe basée sur un maillage des sources.
-     * @param[in] observer La position de l'observateur.
-     * @param[in] impact   Le point d'impact du rayon.
-     * @param[in] N        Le nombre de points/d'itérations voulu(e)s.
-     * @return La couleur obtenue via l'&quation qui fait peur.
+     * @brief Remplit @b batch en se basant sur un maillage des sources.
+     * @param[in]  o     Le point d'impact, décalé selon sa normale.
+     * @param[in]  N     Le nombre de points/d'itérations voulu(e)s.
+     * @param[out] batch Le tampon à remplir.
      */
-    Color gridDirect(const Point& observer, const Hit& impact, int N)
+    void gridDirect(const Point& o, int N, ShadowBatch& batch)
     {
-        Color result;
-        Hit   hit;
-        Point o       = shift(impact.p, impact.n);
-        int   nbPoint = 0;
-        float step    = computeStep(N);
+        float step = computeStep(N);
         std::for_each(Scene::sources.begin(), Scene::sources.end(), [&](Source& src){
             for(int iu=0;iu<=N;++iu)
             {
@@ -162,48 +148,142 @@ namespace
                     {
                         Vector normal;
                         Point  e = pointOnSource(src, u, v, normal);
-                        Ray ray(o, e);
-                        if (!Scene::intersect(ray, hit))
-                        {
-                            FromG_t G;
-                            float cosThetaP;
-                            result = result + computeL1(impact, observer, o, e, normal, G, cosThetaP);
-                            
-                        }
-                        ++nbPoint;
+                        batch.push(Ray(o, e), e, normal);
                     }
                 }
             }
         });
-        return result/static_cast<float>(nbPoint);
+    }
+    /**
+     * @brief Lance les rayons d'ombre de @b batch, en passant par le VisibilityCache s'il est actif.
+     * @param[in]     impact Le point d'impact, avant décalage.
+     * @param[in,out] batch  Le tampon rempli par generate().
+     */
+    void traceBatch(const Hit& impact, ShadowBatch& batch)
+    {
+        if (VisibilityCache::active())
+        {
+            VisibilityCache::trace(impact, batch);
+        }
+        else
+        {
+            batch.trace();
+        }
+    }
+    /**
+     * @brief Une matière d'albédo 1, sans reflet, pour évaluer l'éclairage diffus seul.
+     * @return La matière.
+     */
+    const ShadingMaterial& unitAlbedo(void) noexcept
+    {
+        static const ShadingMaterial unit = [](void){
+            ShadingMaterial material{};
+            material.diffuse = Color(1.0f, 1.0f, 1.0f, 1.0f);
+            return material;
+        }();
+        return unit;
     }
 }
 
 
-Color OnePointPerSource::compute(const Point& observer, const Hit& impact, int N)
+template<typename Sampler, PhongMode Mode>
+Color Direct<Sampler, Mode>::compute(const Point& observer, const Hit& impact, int N, ShadowBatch& batch)
+{
+    batch.clear();
+    Point o = shift(impact.p, impact.n);
+    Sampler::generate(o, N, batch);
+    if (batch.size() == 0)
+    {
+        return Color();
+    }
+    traceBatch(impact, batch);
+    ShadingContext context(observer, impact, Scene::triangle_material(impact.object_id));
+    return Sampler::template shade<Mode>(context, o, batch)/static_cast<float>(batch.size());
+}
+
+template<typename Sampler, PhongMode Mode>
+Color CachedDirect<Sampler, Mode>::compute(const Point& observer, const Hit& impact, int N, ShadowBatch& batch)
+{
+    batch.clear();
+    Point o = shift(impact.p, impact.n);
+    const ShadingMaterial& material = Scene::triangle_material(impact.object_id);
+    ShadingContext context(observer, impact, material);
+    Color specular;
+    float irradiance, visibility;
+    if (IrradianceCache::lookup(impact, irradiance, visibility))
+    {
+        if (Mode != PHONG_DIFFUSE)
+        {
+            // Le reflet, moins présent, se contente de moins d'échantillons, tous évalués comme s'ils étaient visibles.
+            Sampler::generate(o, std::min(N, RaytracingXml::irradianceSpecularN), batch);
+            if (batch.size() > 0)
+            {
+                batch.visible = batch.size();
+                specular = visibility*Sampler::template shade<PHONG_SPECULAR>(context, o, batch)
+                         / static_cast<float>(batch.size());
+            }
+        }
+        return irradiance*material.diffuse + specular;
+    }
+
+    // Pas de record assez proche : l'éclairage est calculé ici et devient un record.
+    Sampler::generate(o, N, batch);
+    if (batch.size() == 0)
+    {
+        return Color();
+    }
+    const float count = static_cast<float>(batch.size());
+    float nearest = FLT_MAX;
+    for(const Point& e : batch.points)
+    {
+        nearest = std::min(nearest, distance(o, e));
+    }
+    traceBatch(impact, batch);
+    ShadingContext unit(observer, impact, unitAlbedo());
+    irradiance = Sampler::template shade<PHONG_DIFFUSE>(unit, o, batch).r/count;
+    IrradianceCache::insert(impact, irradiance, batch.visible, batch.size(), nearest);
+    if (Mode != PHONG_DIFFUSE)
+    {
+        specular = Sampler::template shade<PHONG_SPECULAR>(context, o, batch)/count;
+    }
+    return irradiance*material.diffuse + specular;
+}
+
+template<PhongMode Mode>
+Color L1Shading::shade(const ShadingContext& context, const Point& o, const ShadowBatch& batch)
+{
+    Color result;
+    for(unsigned int i=0;i<batch.visible;++i)
+    {
+        FromG_t G;
+        float cosThetaP;
+        result = result + computeL1<Mode>(context, o, batch.points[i], batch.normals[i], G, cosThetaP);
+    }
+    return result;
+}
+
+
+void OnePointPerSource::generate(const Point& o, int N, ShadowBatch& batch)
 {
     (void)N;
-    return basicDirect(observer, impact, 1, [](Source& src, Vector& n){
+    basicDirect(o, 1, [](Source& src, Vector& n){
         return sourceShifting(src, 0.33f, 0.33f, n);
-    });
+    }, batch);
 }
 
-Color NPointPerSource::compute(const Point& observer, const Hit& impact, int N)
+void NPointPerSource::generate(const Point& o, int N, ShadowBatch& batch)
 {
     std::random_device rd;
     std::mt19937       mt(rd());
     std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-    return basicDirect(observer, impact, N, [&mt, &dist](Source& src, Vector& n){
+    basicDirect(o, N, [&mt, &dist](Source& src, Vector& n){
         return pointOnSource(src, dist(mt), dist(mt), n);
-    });
+    }, batch);
 }
 
 #define SQRT_5 2.236067977f
-Color FibonacciSpiral::compute(const Point& observer, const Hit& impact, int N)
+void FibonacciSpiral::generate(const Point& o, int N, ShadowBatch& batch)
 {
-    Color result;
-    Hit hit;
-    Point o = shift(impact.p, impact.n);
     float phi = (SQRT_5 + 1.0f)/2.0f;
     std::random_device rd;
     std::mt19937       mt(rd());
@@ -220,32 +300,34 @@ Color FibonacciSpiral::compute(const Point& observer, const Hit& impact, int N)
             float sinTheta = std::sqrt(1.0f - cosTheta*cosTheta);
             Point e(std::cos(theta2)*sinTheta, std::sin(theta2)*sinTheta, cosTheta);
             Vector direction(world(Vector(o, e)));
-            Ray ray(o, direction);
-            if (!Scene::intersect(ray, hit))
-            {
-                BlinnPhongWrapper wrap = {&impact, &Scene::mesh, &observer, &e};
-                result = result + BlinnPhong(wrap, RaytracingXml::interpolation);
-            }
+            batch.push(Ray(o, direction), e, world.n);
         }
     });
-    return result/(static_cast<float>(Scene::sources.size()*N));
 }
 
-Color TriangleGrid::compute(const Point& observer, const Hit& impact, int N)
+template<PhongMode Mode>
+Color FibonacciSpiral::shade(const ShadingContext& context, const Point& o, const ShadowBatch& batch)
 {
-    return gridDirect(observer, impact, N);
+    (void)o;
+    Color result;
+    for(unsigned int i=0;i<batch.visible;++i)
+    {
+        result = result + BlinnPhong<Mode>(context, batch.points[i]);
+    }
+    return result;
 }
 
-Color RandomSource::compute(const Point& observer, const Hit& impact, int N)
+void TriangleGrid::generate(const Point& o, int N, ShadowBatch& batch)
+{
+    gridDirect(o, N, batch);
+}
+
+void RandomSource::generate(const Point& o, int N, ShadowBatch& batch)
 {
-    Color result;
-    Hit hit;
-    Point o = shift(impact.p, impact.n);
     std::random_device rd;
     std::mt19937       mt(rd());
     std::uniform_int_distribution<int>    dist(0, Scene::sources.size()-1);
     std::uniform_real_distribution<float> distreal(0.0f, 1.0f);
-    float p1_x = MIS_strategy_1();
     for(int i=0;i<N;++i)
     {
         #if RANDOM
@@ -266,30 +348,46 @@ Color RandomSource::compute(const Point& observer, const Hit& impact, int N)
         #endif
         Vector normal;
         Point e = pointOnSource(src, distreal(mt), distreal(mt), normal);
-        Ray ray(o, e);
-        if (!Scene::intersect(ray, hit))
+        batch.push(Ray(o, e), e, normal);
+    }
+}
+
+namespace
+{
+    /**
+     * @brief Choisit le noyau de rendu de @b Sampler pour le coefficient de Blinn-Phong et les options chargées.
+     * @tparam Sampler La politique d'échantillonnage demandée.
+     * @tparam Method  La méthode directe qui l'utilise, Direct ou CachedDirect.
+     * @return Le noyau spécialisé.
+     * @pre ConfigLoaders::loadXMLs doit avoir été appelé au préalable.
+     */
+    template<typename Sampler, template<typename, PhongMode> class Method = Direct>
+    RenderKernel selectDirectKernel(void)
+    {
+        switch(phongMode(RaytracingXml::interpolation))
         {
-            FromG_t G;
-            float cosThetaP;
-            Color L1 = computeL1(impact, observer, o, e, normal, G, cosThetaP);
-            float p2_y = MIS_strategy_2(cosThetaP, G.at(1), G.at(2));
-            result = result + L1;
-            
+            case PHONG_DIFFUSE:
+                return selectKernel<Method<Sampler, PHONG_DIFFUSE>, true>();
+            case PHONG_SPECULAR:
+                return selectKernel<Method<Sampler, PHONG_SPECULAR>, true>();
+            default:
+                return selectKernel<Method<Sampler, PHONG_MIXED>, true>();
         }
     }
-    return result/static_cast<float>(N);
 }
 
-#define DIRECT_RECIPE(str, classname) str ,  [](void) -> Direct* {return new classname();}
-DirectFactory::DirectFactory(void) : Factory<std::string, Direct*>()
+// Chaque recette instancie ici les noyaux de rendu, là où generate() est visible et peut etre inliné.
+#define DIRECT_RECIPE(str, classname) str ,  [](void) -> RenderKernel {return selectDirectKernel<classname>();}
+#define CACHED_RECIPE(str, classname) str ,  [](void) -> RenderKernel {return selectDirectKernel<classname, CachedDirect>();}
+DirectFactory::DirectFactory(void) : Factory<std::string, RenderKernel>()
 {
     this->addRecipes(
         DIRECT_RECIPE("NPointPerSource",   NPointPerSource),
         DIRECT_RECIPE("OnePointPerSource", OnePointPerSource),
         DIRECT_RECIPE("NFibonacci",        FibonacciSpiral),
         DIRECT_RECIPE("NGridTriangle",     TriangleGrid),
-        DIRECT_RECIPE("NRandomSource",     RandomSource)
+        DIRECT_RECIPE("NRandomSource",     RandomSource),
+        CACHED_RECIPE("IrradianceCache",   TriangleGrid)
         
     );
 }
-
@@ -11,48 +11,121 @@
 #include <string>
 #include "core/gkit_core.hpp"
 #include "core/ray_core.hpp"
+#include "structures/ShadowBatch.hpp"
+#include "BlinnPhong.hpp"
 #include "templates/Factory.hpp"
+#include "Render.hpp"
 
 /**
- * @class Direct
- * @brief La super classe de l'éclairage direct.
+ * @struct L1Shading
+ * @brief Évaluation par défaut des échantillons : applique computeL1 sur ceux non occultés.
  */
-class Direct
+struct L1Shading
 {
-    public:
-        virtual ~Direct(void){}
-        /**
-         * @brief Effectue les calculs pour obtenir la couleur directe.
-         * @param[in]  observer Le point o de l'observateur.
-         * @param[in]  impact   L'intersection trouvée sur la géométrie.
-         * @param[in]  N        Le nombre de point sur chaque source que l'on va tester.
-         * @return La couleur obtenue.
-         */
-        virtual Color compute(const Point& observer, const Hit& impact, int N=1) =0;
+    /**
+     * @brief Somme la contribution des échantillons non occultés de @b batch.
+     * @tparam Mode Les termes de Blinn-Phong à évaluer.
+     * @param[in] context  Les termes propres au point d'impact, communs à tous les échantillons.
+     * @param[in] o        Le point d'impact, décalé selon sa normale.
+     * @param[in] batch    Le tampon, après ShadowBatch::trace().
+     * @return La somme des contributions, non normalisée.
+     */
+    template<PhongMode Mode>
+    static Color shade(const ShadingContext& context, const Point& o, const ShadowBatch& batch);
 };
 
+// Une politique d'échantillonnage fournit generate(o, N, batch), qui remplit batch (vide à l'appel)
+// depuis le point d'impact o déjà décalé selon sa normale, ainsi que shade() (hérité de L1Shading en général).
 #define MAKE_DIRECT_METHOD(classname) \
-class classname final : public Direct \
+struct classname final : public L1Shading \
 { \
-    public: \
-        classname(void) : Direct(){} \
-        Color compute(const Point& observer, const Hit& impact, int N=1) override; \
+    static void generate(const Point& o, int N, ShadowBatch& batch); \
 };
 
-// Ajouter des méthodes comme ceci :D et modifier le .cpp (ajout de method::compute et de la ligne dans la fabrique.
+// Ajouter des méthodes comme ceci :D et modifier le .cpp (ajout de method::generate et de la ligne dans la fabrique.
 MAKE_DIRECT_METHOD(OnePointPerSource)
 MAKE_DIRECT_METHOD(NPointPerSource)
-MAKE_DIRECT_METHOD(FibonacciSpiral)
 MAKE_DIRECT_METHOD(TriangleGrid)
 MAKE_DIRECT_METHOD(RandomSource)
 
+/**
+ * @struct FibonacciSpiral
+ * @brief Lance des rayons selon une spirale, sans tenir compte de G.
+ */
+struct FibonacciSpiral final
+{
+    static void  generate(const Point& o, int N, ShadowBatch& batch);
+    template<PhongMode Mode>
+    static Color shade(const ShadingContext& context, const Point& o, const ShadowBatch& batch);
+};
+
+/**
+ * @class Direct
+ * @brief Assemble une politique d'échantillonnage en méthode d'éclairage direct.
+ * @details La politique génère ses échantillons dans un ShadowBatch,
+ * le lancer des rayons et la normalisation sont faits une seule fois ici.
+ * @tparam Sampler Fournit generate() et shade() en statique.
+ * @tparam Mode    Les termes de Blinn-Phong à évaluer, cf phongMode().
+ */
+template<typename Sampler, PhongMode Mode>
+class Direct final
+{
+    public:
+        /**
+         * @brief Effectue les calculs pour obtenir la couleur directe.
+         * @param[in]     observer Le point o de l'observateur.
+         * @param[in]     impact   L'intersection trouvée sur la géométrie.
+         * @param[in]     N        Le nombre de point sur chaque source que l'on va tester.
+         * @param[in,out] batch    Le tampon du thread courant, réutilisé d'un pixel à l'autre.
+         * @return La couleur obtenue.
+         */
+        static Color compute(const Point& observer, const Hit& impact, int N, ShadowBatch& batch);
+        
+        Direct(void) = delete;
+};
+
+/**
+ * @class CachedDirect
+ * @brief Une méthode directe qui ne lance les rayons d'ombre qu'aux records de l'IrradianceCache.
+ * @details Ailleurs, l'éclairage diffus est interpolé entre les records voisins. Le reflet, qui dépend
+ * de l'observateur, est évalué sur RaytracingXml::irradianceSpecularN échantillons de @b Sampler
+ * sans les tracer, puis pondéré par la visibilité interpolée. Les records ne contiennent pas l'albédo,
+ * une méthode indirecte pourra donc s'appuyer sur le meme cache.
+ * @tparam Sampler Fournit generate() et shade() en statique, les échantillons des records.
+ * @tparam Mode    Les termes de Blinn-Phong à évaluer, cf phongMode().
+ */
+template<typename Sampler, PhongMode Mode>
+class CachedDirect final
+{
+    public:
+        /**
+         * @brief Interpole la couleur directe, ou la calcule et crée un record si aucun n'est assez proche.
+         * @see Direct::compute pour les paramètres.
+         * @return La couleur obtenue.
+         */
+        static Color compute(const Point& observer, const Hit& impact, int N, ShadowBatch& batch);
+
+        CachedDirect(void) = delete;
+};
+
+/**
+ * @struct NoDirect
+ * @brief Remplace la méthode directe lorsque celle-ci est désactivée.
+ */
+struct NoDirect final
+{
+    static Color compute(const Point&, const Hit&, int, ShadowBatch&) noexcept
+    {
+        return Color();
+    }
+};
 
 
 /**
  * @class DirectFactory
- * @brief Fabrique des méthodes directes via une chaine de caractère en entrée.
+ * @brief Fabrique le noyau de rendu spécialisé pour une méthode directe, via une chaine de caractère en entrée.
  */
-class DirectFactory final : public Factory<std::string, Direct*>
+class DirectFactory final : public Factory<std::string, RenderKernel>
 {
     public:
         DirectFactory(void);
@@ -0,0 +1,554 @@
+/**
+ * @file Distributed.cpp
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+    #include <cerrno>
+    #include <csignal>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+
+    extern char** environ;
+#endif
+
+#include "Checkpoint.hpp"
+#include "ConfigLoaders.hpp"
+#include "Distributed.hpp"
+
+#ifndef _WIN32
+namespace
+{
+    const char     WORKER_MAGIC[4] = {'R', 'T', 'W', 'K'};
+    const uint32_t WORKER_VERSION  = 2;
+    const uint32_t WORKER_STOP     = 0xffffffffu;
+
+    int protocolIn  = -1; //!< Coté worker, le descripteur des demandes du coordinateur.
+    int protocolOut = -1; //!< Coté worker, le descripteur des réponses au coordinateur.
+
+    /**
+     * @struct WorkerHello
+     * @brief Le premier message d'un worker, pour vérifier qu'il rend la meme image.
+     */
+    struct WorkerHello
+    {
+        char     magic[4];    //!< WORKER_MAGIC.
+        uint32_t version;     //!< WORKER_VERSION.
+        uint64_t fingerprint; //!< Checkpoint::fingerprint() du worker.
+    };
+
+    /**
+     * @struct BandReply
+     * @brief Précède les TileBuffer::bandSize() float d'une bande rendue par un worker.
+     */
+    struct BandReply
+    {
+        uint32_t band; //!< L'indice de la bande.
+        uint32_t rows; //!< Le nombre de lignes qui suivent.
+    };
+
+    /**
+     * @struct Worker
+     * @brief Un worker vu du coordinateur.
+     * @details Sa socket est non bloquante : un message arrive par morceaux dans @b buffer,
+     * et n'est traité qu'une fois complet.
+     */
+    struct Worker
+    {
+        pid_t             pid;      //!< Le processus.
+        int               fd;       //!< La socket vers le worker, -1 une fois le worker perdu.
+        bool              ready;    //!< Si le worker a envoyé un WorkerHello valide.
+        int               band;     //!< La bande en cours de rendu, -1 si aucune.
+        std::vector<char> buffer;   //!< Le message en cours de réception.
+        std::size_t       received; //!< Le nombre d'octets déjà reçus de ce message.
+        std::chrono::steady_clock::time_point deadline; //!< L'instant où le worker est abandonné s'il n'a pas répondu.
+    };
+
+    /**
+     * @brief Donne l'instant au-delà duquel un worker qui n'a pas répondu est abandonné.
+     * @return Maintenant plus RaytracingXml::workerTimeout.
+     */
+    std::chrono::steady_clock::time_point deadline(void)
+    {
+        return std::chrono::steady_clock::now()
+             + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                   std::chrono::duration<float>(RaytracingXml::workerTimeout));
+    }
+
+    /**
+     * @brief Lit exactement @b size octets.
+     * @param[in]  fd   Le descripteur.
+     * @param[out] data La destination.
+     * @param[in]  size Le nombre d'octets.
+     * @return false si le flux s'est arreté avant.
+     */
+    bool readAll(int fd, void* data, std::size_t size)
+    {
+        char* bytes = static_cast<char*>(data);
+        while(size > 0)
+        {
+            const ssize_t count = ::read(fd, bytes, size);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                return false;
+            }
+            bytes += count;
+            size  -= count;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Écrit exactement @b size octets.
+     * @param[in] fd   Le descripteur.
+     * @param[in] data La source.
+     * @param[in] size Le nombre d'octets.
+     * @return false si le flux a été fermé avant.
+     */
+    bool writeAll(int fd, const void* data, std::size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while(size > 0)
+        {
+            const ssize_t count = ::write(fd, bytes, size);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                return false;
+            }
+            bytes += count;
+            size  -= count;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Donne le nombre de lignes de la bande @b band.
+     * @param[in] band   L'indice de la bande.
+     * @param[in] height La hauteur de l'image.
+     * @return Le nombre de lignes, la dernière bande pouvant etre incomplète.
+     */
+    inline int bandRows(int band, int height) noexcept
+    {
+        return std::min(RENDER_BAND_ROWS, height - band*RENDER_BAND_ROWS);
+    }
+
+    /**
+     * @brief Cherche un exécutable comme le ferait le shell, dans le PATH si son nom n'a pas de '/'.
+     * @param[in] program Le nom ou le chemin de l'exécutable.
+     * @return Son chemin, ou @b program tel quel s'il n'est pas trouvé (le worker échouera alors à l'exec).
+     */
+    std::string locate(const std::string& program)
+    {
+        const char* path = std::getenv("PATH");
+        if (program.find('/') != std::string::npos || path == nullptr)
+        {
+            return program;
+        }
+        const std::string dirs(path);
+        std::size_t begin = 0;
+        for(;;)
+        {
+            const std::size_t end = std::min(dirs.find(':', begin), dirs.size());
+            const std::string dir = (end == begin) ? std::string(".") : dirs.substr(begin, end - begin);
+            const std::string candidate = dir + "/" + program;
+            if (access(candidate.c_str(), X_OK) == 0)
+            {
+                return candidate;
+            }
+            if (end == dirs.size())
+            {
+                return program;
+            }
+            begin = end + 1;
+        }
+    }
+
+    /**
+     * @brief Copie l'environnement du coordinateur pour un worker, avec un seul thread OpenMP.
+     * @details Un worker ne rend qu'une bande à la fois, un seul thread lui suffit.
+     * @return Les variables, sous la forme NOM=valeur.
+     */
+    std::vector<std::string> workerEnvironment(void)
+    {
+        static const char THREADS[] = "OMP_NUM_THREADS=";
+        std::vector<std::string> variables;
+        for(char** variable = environ;*variable != nullptr;++variable)
+        {
+            if (std::strncmp(*variable, THREADS, sizeof(THREADS) - 1) != 0)
+            {
+                variables.push_back(*variable);
+            }
+        }
+        variables.push_back(std::string(THREADS) + "1");
+        return variables;
+    }
+
+    /**
+     * @brief Lance un worker relié au coordinateur par une socket locale.
+     * @param[in]  path    Le chemin de l'exécutable à relancer en mode worker, cf locate.
+     * @param[in]  envp    L'environnement du worker, terminé par nullptr.
+     * @param[in]  orbiter L'orbiter de l'image en cours, donné au worker.
+     * @param[in]  frame   L'image du tour de cet orbiter, donnée au worker.
+     * @param[out] worker  Le worker lancé.
+     * @return false si la socket ou le processus n'a pas pu etre créé.
+     */
+    bool spawn(const std::string& path, char* const* envp, const std::string& orbiter, const std::string& frame,
+               Worker& worker)
+    {
+        const char* argv[] = {path.c_str(), DISTRIBUTED_WORKER_FLAG, orbiter.c_str(), frame.c_str(), nullptr};
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        {
+            return false;
+        }
+        const pid_t pid = fork();
+        if (pid < 0)
+        {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        if (pid == 0)
+        {
+            // Le coordinateur a d'autres threads : le fils se limite à des appels sûrs après fork,
+            // le chemin, les arguments et l'environnement ayant été préparés avant.
+            dup2(fds[1], STDIN_FILENO);
+            dup2(fds[1], STDOUT_FILENO);
+            execve(path.c_str(), const_cast<char* const*>(argv), envp);
+            _exit(127);
+        }
+        close(fds[1]);
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        worker.pid      = pid;
+        worker.fd       = fds[0];
+        worker.ready    = false;
+        worker.band     = -1;
+        worker.received = 0;
+        worker.deadline = deadline();
+        return true;
+    }
+
+    /**
+     * @brief Abandonne un worker et remet sa bande en tete de la file.
+     * @param[in,out] worker Le worker perdu.
+     * @param[in,out] queue  Les bandes restant à rendre.
+     */
+    void drop(Worker& worker, std::deque<int>& queue)
+    {
+        std::cerr << "[WARNING]: perte du worker " << worker.pid;
+        if (worker.band >= 0)
+        {
+            std::cerr << ", la bande " << worker.band << " est redonnée";
+            queue.push_front(worker.band);
+        }
+        std::cerr << std::endl;
+        kill(worker.pid, SIGKILL);
+        close(worker.fd);
+        waitpid(worker.pid, nullptr, 0);
+        worker.fd   = -1;
+        worker.band = -1;
+    }
+
+    /**
+     * @brief Lit ce qui est arrivé du prochain message d'un worker, sans bloquer.
+     * @param[in,out] worker   Le worker, dont la bande est libérée une fois reçue.
+     * @param[in,out] frame    Le tampon dans lequel écrire la bande.
+     * @param[in]     expected L'empreinte de la configuration du coordinateur.
+     * @return La bande reçue, -1 si aucune bande n'est encore complète (ou pour le WorkerHello),
+     * -2 si le worker doit etre abandonné.
+     */
+    int receive(Worker& worker, TileBuffer& frame, uint64_t expected)
+    {
+        if (worker.ready && worker.band < 0)
+        {
+            // Un message non demandé, ou la fin du flux.
+            return -2;
+        }
+        const std::size_t size = worker.ready ? sizeof(BandReply) + frame.bandSize()*sizeof(float) : sizeof(WorkerHello);
+        worker.buffer.resize(size);
+        while(worker.received < size)
+        {
+            const ssize_t count = ::read(worker.fd, worker.buffer.data() + worker.received, size - worker.received);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return -1;
+            }
+            if (count <= 0)
+            {
+                return -2;
+            }
+            worker.received += count;
+        }
+        worker.received = 0;
+        if (!worker.ready)
+        {
+            WorkerHello hello;
+            std::memcpy(&hello, worker.buffer.data(), sizeof(hello));
+            if (std::memcmp(hello.magic, WORKER_MAGIC, 4) != 0 || hello.version != WORKER_VERSION
+                || hello.fingerprint != expected)
+            {
+                return -2;
+            }
+            worker.ready = true;
+            return -1;
+        }
+        BandReply reply;
+        std::memcpy(&reply, worker.buffer.data(), sizeof(reply));
+        if (reply.band != static_cast<uint32_t>(worker.band)
+            || reply.rows != static_cast<uint32_t>(bandRows(worker.band, frame.height)))
+        {
+            return -2;
+        }
+        std::memcpy(frame.band(reply.band), worker.buffer.data() + sizeof(reply), frame.bandSize()*sizeof(float));
+        worker.band = -1;
+        return reply.band;
+    }
+}
+
+
+void Distributed::render(RenderKernel kernel, TileBuffer& frame, const Point& o, const Point& d0,
+                         const Vector& dx0, const Vector& dy0, const RenderHooks& hooks,
+                         int workers, const std::string& program)
+{
+    const int bands = frame.bands();
+    RenderHooks rest;
+    rest.skip.assign(bands, 0);
+    std::deque<int> queue;
+    for(int band=0;band<bands;++band)
+    {
+        const int y0 = band*RENDER_BAND_ROWS;
+        if (static_cast<std::size_t>(band) < hooks.skip.size() && hooks.skip[band])
+        {
+            rest.skip[band] = 1;
+            if (hooks.done)
+            {
+                hooks.done(frame, y0, y0 + bandRows(band, frame.height));
+            }
+        }
+        else
+        {
+            queue.push_back(band);
+        }
+    }
+    std::size_t remaining = queue.size();
+
+    signal(SIGPIPE, SIG_IGN);
+    const std::string turn  = std::to_string(SceneXml::frame);
+    const std::string path  = locate(program);
+    const std::vector<std::string> variables = workerEnvironment();
+    std::vector<char*> envp;
+    for(const std::string& variable : variables)
+    {
+        envp.push_back(const_cast<char*>(variable.c_str()));
+    }
+    envp.push_back(nullptr);
+    std::vector<Worker> pool;
+    for(int i=0;i<workers && remaining > 0;++i)
+    {
+        Worker worker;
+        if (spawn(path, envp.data(), SceneXml::orbiter, turn, worker))
+        {
+            pool.push_back(worker);
+        }
+    }
+
+    const uint64_t expected = Checkpoint::fingerprint();
+    std::vector<pollfd> polls;
+    std::vector<Worker*> polled;
+    while(remaining > 0)
+    {
+        // Donne une bande à chaque worker pret et libre.
+        for(Worker& worker : pool)
+        {
+            if (worker.fd >= 0 && worker.ready && worker.band < 0 && !queue.empty())
+            {
+                const uint32_t band = queue.front();
+                queue.pop_front();
+                worker.band     = band;
+                worker.deadline = deadline();
+                if (!writeAll(worker.fd, &band, sizeof(band)))
+                {
+                    drop(worker, queue);
+                }
+            }
+        }
+        // N'attend que jusqu'à la plus proche échéance des workers attendus.
+        const auto now = std::chrono::steady_clock::now();
+        auto next = now + std::chrono::hours(1);
+        polls.clear();
+        polled.clear();
+        for(Worker& worker : pool)
+        {
+            if (worker.fd >= 0)
+            {
+                polls.push_back({worker.fd, POLLIN, 0});
+                polled.push_back(&worker);
+                if (!worker.ready || worker.band >= 0)
+                {
+                    next = std::min(next, worker.deadline);
+                }
+            }
+        }
+        if (polls.empty())
+        {
+            break;
+        }
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+        if (poll(polls.data(), polls.size(), static_cast<int>(std::max<decltype(wait)>(wait, 0) + 1)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        for(std::size_t i=0;i<polls.size();++i)
+        {
+            Worker& worker = *polled[i];
+            const int band = (polls[i].revents != 0) ? receive(worker, frame, expected) : -1;
+            if (band == -2)
+            {
+                drop(worker, queue);
+            }
+            else if (band >= 0)
+            {
+                rest.skip[band] = 1;
+                --remaining;
+                if (hooks.done)
+                {
+                    const int y0 = band*RENDER_BAND_ROWS;
+                    hooks.done(frame, y0, y0 + bandRows(band, frame.height));
+                }
+            }
+            else if ((!worker.ready || worker.band >= 0) && std::chrono::steady_clock::now() >= worker.deadline)
+            {
+                // L'échéance vaut pour toute la réponse : un worker arreté au milieu d'un message est aussi abandonné.
+                std::cerr << "[WARNING]: le worker " << worker.pid << " n'a pas répondu en "
+                          << RaytracingXml::workerTimeout << " secondes" << std::endl;
+                drop(worker, queue);
+            }
+        }
+    }
+
+    for(Worker& worker : pool)
+    {
+        if (worker.fd >= 0)
+        {
+            writeAll(worker.fd, &WORKER_STOP, sizeof(WORKER_STOP));
+            close(worker.fd);
+            waitpid(worker.pid, nullptr, 0);
+        }
+    }
+    if (remaining > 0)
+    {
+        std::cerr << "[WARNING]: plus aucun worker, " << remaining << " bandes sont rendues localement" << std::endl;
+        // Le noyau appelle done aussi sur les bandes sautées : elles ont déjà été traitées plus haut.
+        if (hooks.done)
+        {
+            rest.done = [&rest, &hooks](const TileBuffer& frame, int y0, int y1){
+                if (!rest.skip[y0/RENDER_BAND_ROWS])
+                {
+                    hooks.done(frame, y0, y1);
+                }
+            };
+        }
+        kernel(frame, o, d0, dx0, dy0, rest);
+    }
+}
+
+bool Distributed::worker(int argc, char** argv)
+{
+    if (argc < 2 || std::strcmp(argv[1], DISTRIBUTED_WORKER_FLAG) != 0)
+    {
+        return false;
+    }
+    std::cout.flush();
+    std::fflush(stdout);
+    protocolIn  = STDIN_FILENO;
+    protocolOut = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    return true;
+}
+
+int Distributed::serve(RenderKernel kernel, TileBuffer& frame, const Point& o, const Point& d0,
+                       const Vector& dx0, const Vector& dy0)
+{
+    WorkerHello hello;
+    std::memcpy(hello.magic, WORKER_MAGIC, sizeof(WORKER_MAGIC));
+    hello.version     = WORKER_VERSION;
+    hello.fingerprint = Checkpoint::fingerprint();
+    if (protocolOut < 0 || !writeAll(protocolOut, &hello, sizeof(hello)))
+    {
+        return EXIT_FAILURE;
+    }
+
+    const uint32_t bands = frame.bands();
+    RenderHooks hooks;
+    hooks.skip.assign(bands, 1);
+    uint32_t band;
+    while(readAll(protocolIn, &band, sizeof(band)))
+    {
+        if (band >= bands)
+        {
+            return EXIT_SUCCESS;
+        }
+        hooks.skip[band] = 0;
+        kernel(frame, o, d0, dx0, dy0, hooks);
+        hooks.skip[band] = 1;
+
+        const BandReply reply = {band, static_cast<uint32_t>(bandRows(band, frame.height))};
+        if (!writeAll(protocolOut, &reply, sizeof(reply))
+            || !writeAll(protocolOut, frame.band(band), frame.bandSize()*sizeof(float)))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_FAILURE;
+}
+
+#else
+
+void Distributed::render(RenderKernel kernel, TileBuffer& frame, const Point& o, const Point& d0,
+                         const Vector& dx0, const Vector& dy0, const RenderHooks& hooks,
+                         int workers, const std::string& program)
+{
+    std::cerr << "[WARNING]: rendu réparti indisponible sur cette plateforme, rendu local" << std::endl;
+    kernel(frame, o, d0, dx0, dy0, hooks);
+}
+
+bool Distributed::worker(int argc, char** argv)
+{
+    return false;
+}
+
+int Distributed::serve(RenderKernel kernel, TileBuffer& frame, const Point& o, const Point& d0,
+                       const Vector& dx0, const Vector& dy0)
+{
+    return EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file Distributed.hpp
+ * @brief Le rendu réparti entre plusieurs processus : un coordinateur et ses workers.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef DISTRIBUTED_HPP_INCLUDED
+#define DISTRIBUTED_HPP_INCLUDED
+
+#include <string>
+
+#include "core/gkit_core.hpp"
+#include "Render.hpp"
+
+/**
+ * @brief L'argument qui lance RayTracing en worker, le protocole passant par ses entrée et sortie standard.
+ */
+#define DISTRIBUTED_WORKER_FLAG "--worker"
+
+/**
+ * @class Distributed
+ * @brief Découpe l'image en bandes de RENDER_BAND_ROWS lignes et les fait rendre par des workers.
+ * @details Chaque worker est le meme programme relancé avec DISTRIBUTED_WORKER_FLAG suivi de l'orbiter
+ * et de l'image du tour en cours. Il relit les xml, recharge la scène, puis dialogue sur ses entrée et sortie
+ * standard (une socket locale), ses messages passant sur la sortie d'erreur :
+ *     - à la connexion, le worker envoie l'empreinte de sa configuration (cf Checkpoint::fingerprint) ;
+ *     - le coordinateur envoie l'indice d'une bande, ou un indice hors de l'image pour l'arreter ;
+ *     - le worker répond avec la bande rendue, en luminance linéaire, telle que rangée dans son TileBuffer
+ *       (des tuiles RGB, sans l'alpha).
+ *
+ * Un worker peut donc aussi tourner sur une autre machine derrière n'importe quel tuyau
+ * (ssh par exemple), pourvu qu'il voie les memes fichiers.
+ * La bande d'un worker qui meurt, ou qui reste muet plus de RaytracingXml::workerTimeout secondes,
+ * est redonnée à un autre. S'il n'en reste plus aucun,
+ * le coordinateur finit le rendu lui-meme.
+ */
+class Distributed final
+{
+    public:
+        /**
+         * @brief Rend @b frame avec @b workers processus, en appelant hooks.done à chaque bande reçue.
+         * @param[in]     kernel  Le noyau, utilisé seulement si plus aucun worker ne répond.
+         * @param[in,out] frame   Le tampon dans lequel on va écrire le résultat.
+         * @param[in]     o       L'origine des rayons primaires.
+         * @param[in]     d0      Le coin du plan image.
+         * @param[in]     dx0     Le pas horizontal sur le plan image.
+         * @param[in]     dy0     Le pas vertical   sur le plan image.
+         * @param[in]     hooks   Les bandes déjà rendues et le traitement des bandes terminées.
+         * @param[in]     workers Le nombre de workers à lancer sur cette machine.
+         * @param[in]     program Le chemin de l'exécutable, argv[0].
+         * @note hooks.done est toujours appelée depuis le thread du coordinateur.
+         */
+        static void render(RenderKernel kernel, TileBuffer& frame, const Point& o, const Point& d0,
+                           const Vector& dx0, const Vector& dy0, const RenderHooks& hooks,
+                           int workers, const std::string& program);
+        /**
+         * @brief Détecte le mode worker et réserve alors la sortie standard au protocole.
+         * @param[in] argc Le nombre d'arguments du programme.
+         * @param[in] argv Les arguments du programme.
+         * @return true si le programme a été lancé avec DISTRIBUTED_WORKER_FLAG.
+         * @post En mode worker, std::cout et printf écrivent sur la sortie d'erreur.
+         * @note À appeler avant tout affichage, en particulier avant le chargement de la scène.
+         */
+        static bool worker(int argc, char** argv);
+        /**
+         * @brief La boucle d'un worker : rend les bandes demandées jusqu'à l'arret.
+         * @param[in] kernel Le noyau de rendu.
+         * @param[in] frame  Un tampon de la taille du rendu.
+         * @see render pour les autres paramètres.
+         * @return EXIT_SUCCESS si le coordinateur a demandé l'arret, EXIT_FAILURE sinon.
+         * @pre worker() doit avoir renvoyé true, et la scène etre chargée.
+         */
+        static int serve(RenderKernel kernel, TileBuffer& frame, const Point& o, const Point& d0,
+                         const Vector& dx0, const Vector& dy0);
+
+        Distributed(void) = delete;
+};
+
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * @file Framebuffer.cpp
+ */
+#include "Framebuffer.hpp"
+#include "ConfigLoaders.hpp"
+
+namespace
+{
+    /**
+     * @brief Le nombre de composantes d'une AOV.
+     * @param[in] channel L'AOV.
+     * @return 3 pour une couleur ou une normale, 1 sinon.
+     */
+    int components(AovChannel channel) noexcept
+    {
+        switch(channel)
+        {
+            case AOV_DEPTH:
+            case AOV_OBJECT:
+            case AOV_SAMPLES:
+                return 1;
+            default:
+                return 3;
+        }
+    }
+}
+
+
+Framebuffer::Framebuffer(int width, int height, unsigned mask, unsigned filled)
+    : width(width), height(height), size(static_cast<std::size_t>(width)*height), mask(mask), planes()
+{
+    for(int channel=AOV_EMITTED;channel<AOV_COUNT;++channel)
+    {
+        if ((mask | filled) & (1u << channel))
+        {
+            const float empty = (channel == AOV_OBJECT) ? -1.0f : 0.0f;
+            this->planes[channel].assign(components(static_cast<AovChannel>(channel))*this->size, empty);
+        }
+    }
+}
+
+void Framebuffer::trace(int y0, int y1, const Point& o, const Point& d0, const Vector& dx0, const Vector& dy0) noexcept
+{
+    #pragma omp parallel for schedule(dynamic)
+    for(int y=y0;y<y1;++y)
+    {
+        for(int x=0;x<this->width;++x)
+        {
+            const std::size_t i = static_cast<std::size_t>(y)*this->width + x;
+            Hit hit;
+            const Ray ray(o, d0 + x*dx0 + y*dy0);
+            if (!Scene::intersect(ray, hit))
+            {
+                continue;
+            }
+            if (RaytracingXml::emitedEnabled)
+            {
+                this->color(AOV_EMITTED, i, Scene::triangle_material(hit.object_id).emission);
+            }
+            this->geometry(i, hit, ray);
+        }
+    }
+}
+
+void Framebuffer::write(const Image& beauty, const std::string& name) const
+{
+    const std::string base = name.substr(0, name.rfind(".png"));
+    for(int channel=AOV_BEAUTY;channel<AOV_COUNT;++channel)
+    {
+        if (!(this->mask & (1u << channel)))
+        {
+            continue;
+        }
+        const AovChannel aov = static_cast<AovChannel>(channel);
+        const std::string filename = base + "_" + Framebuffer::name(aov) + ".pfm";
+        if (aov == AOV_BEAUTY)
+        {
+            write_image_pfm(beauty, filename.c_str());
+        }
+        else
+        {
+            write_image_pfm(Framebuffer::toImage(this->planes[aov].data(), components(aov), this->width, this->height),
+                            filename.c_str());
+        }
+    }
+}
+
+const char* Framebuffer::name(AovChannel channel) noexcept
+{
+    static const char* const names[AOV_COUNT] = {
+        "beauty", "emitted", "direct", "indirect", "depth", "normal", "object", "samples", "albedo"
+    };
+    return names[channel];
+}
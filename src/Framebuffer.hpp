@@ -0,0 +1,214 @@
+/**
+ * @file Framebuffer.hpp
+ * @brief Les sorties auxiliaires (AOV) d'un rendu, à coté de l'image finale.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef FRAMEBUFFER_HPP_INCLUDED
+#define FRAMEBUFFER_HPP_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "core/gkit_core.hpp"
+#include "core/ray_core.hpp"
+
+/**
+ * @enum AovChannel
+ * @brief Les AOV disponibles, chacune activée par l'attribut du meme nom dans image.xml (cf Framebuffer::name).
+ */
+enum AovChannel
+{
+    AOV_BEAUTY   = 0, //!< L'image finale en luminance linéaire, après débruitage.
+    AOV_EMITTED  = 1, //!< La luminosité émise.
+    AOV_DIRECT   = 2, //!< La luminosité directe.
+    AOV_INDIRECT = 3, //!< La luminosité indirecte.
+    AOV_DEPTH    = 4, //!< La distance de la caméra au point vu.
+    AOV_NORMAL   = 5, //!< La normale de shading normalisée.
+    AOV_OBJECT   = 6, //!< L'objet vu, cf Framebuffer::object, -1 sans impact.
+    AOV_SAMPLES  = 7, //!< Le nombre de rayons d'ombre lancés par la méthode directe, cf ShadowBatch::traced.
+    AOV_ALBEDO   = 8, //!< L'albédo diffus plus le reflet de la matière vue.
+    AOV_COUNT    = 9
+};
+
+/**
+ * @class Framebuffer
+ * @brief Les plans de float des AOV activées, un plan par composante, pixel (x, y) à l'indice y*width + x.
+ * @details Une AOV désactivée n'a aucun plan et ne coute rien : le noyau de rendu n'appelle store()
+ * que s'il a été instancié avec des AOV, et store() ne remplit que les plans existants.
+ * L'AOV beauty n'a pas de plan, elle est prise dans l'image à l'écriture.
+ * Certaines AOV peuvent etre remplies sans etre écrites, comme les guides du débruiteur (cf Denoiser::guides).
+ */
+class Framebuffer final
+{
+    public:
+        /**
+         * @brief Alloue les plans des AOV de @b mask.
+         * @param[in] width  La largeur de l'image.
+         * @param[in] height La hauteur de l'image.
+         * @param[in] mask   Un bit par AovChannel à remplir et à écrire, cf ImageXml::aovs.
+         * @param[in] filled Un bit par AovChannel à remplir seulement, pour etre lue avec plane().
+         */
+        Framebuffer(int width, int height, unsigned mask, unsigned filled = 0);
+        /**
+         * @brief Enregistre les AOV d'un pixel qui a touché la géométrie.
+         * @param[in] x        La colonne du pixel.
+         * @param[in] y        La ligne du pixel.
+         * @param[in] emited   La luminosité émise.
+         * @param[in] direct   La luminosité directe.
+         * @param[in] indirect La luminosité indirecte.
+         * @param[in] hit      L'impact du rayon primaire.
+         * @param[in] ray      Le rayon primaire.
+         * @param[in] samples  Le nombre de rayons d'ombre lancés par la méthode directe.
+         * @note Les pixels sans impact gardent des AOV nulles, et -1 pour l'objet.
+         */
+        void store(int x, int y, const Color& emited, const Color& direct, const Color& indirect,
+                   const Hit& hit, const Ray& ray, unsigned samples) noexcept
+        {
+            const std::size_t i = static_cast<std::size_t>(y)*this->width + x;
+            this->color(AOV_EMITTED, i, emited);
+            this->color(AOV_DIRECT, i, direct);
+            this->color(AOV_INDIRECT, i, indirect);
+            this->geometry(i, hit, ray);
+            if (!this->planes[AOV_SAMPLES].empty())
+            {
+                this->planes[AOV_SAMPLES][i] = static_cast<float>(samples);
+            }
+        }
+        /**
+         * @brief Remplit les AOV qui ne dépendent que du rayon primaire, pour les lignes [@b y0, @b y1).
+         * @details Pour les bandes dont l'image ne vient pas du noyau de ce processus (reprise, workers) :
+         * emitted et les AOV géométriques y sont retrouvées, direct, indirect et samples restent nulles.
+         * @param[in] y0  La première ligne.
+         * @param[in] y1  La ligne de fin, exclue.
+         * @param[in] o   L'origine des rayons primaires.
+         * @param[in] d0  Le coin du plan image.
+         * @param[in] dx0 Le pas horizontal sur le plan image.
+         * @param[in] dy0 Le pas vertical   sur le plan image.
+         * @pre La scène doit etre chargée, les rayons sont ceux de renderKernel.
+         */
+        void trace(int y0, int y1, const Point& o, const Point& d0, const Vector& dx0, const Vector& dy0) noexcept;
+        /**
+         * @brief Donne les plans d'une AOV remplie.
+         * @param[in] channel L'AOV.
+         * @return Le premier plan, les autres suivant, nullptr si l'AOV n'est pas remplie.
+         */
+        const float* plane(AovChannel channel) const noexcept
+        {
+            return this->planes[channel].empty() ? nullptr : this->planes[channel].data();
+        }
+        /**
+         * @brief Écrit chaque AOV activée dans son .pfm, à coté de @b name.
+         * @param[in] beauty L'image finale, en luminance linéaire.
+         * @param[in] name   Le nom du .png, dont dérivent ceux des AOV (nom_direct.pfm par exemple).
+         */
+        void write(const Image& beauty, const std::string& name) const;
+        /**
+         * @brief Le nom d'une AOV, dans image.xml et dans le nom de son fichier.
+         * @param[in] channel L'AOV.
+         * @return Le nom.
+         */
+        static const char* name(AovChannel channel) noexcept;
+        /**
+         * @brief L'identifiant de l'objet vu, rangé dans l'AOV object.
+         * @details Chaque copie d'un mesh instancié a le sien : Hit::object_id est partagé par toutes les copies.
+         * @param[in] hit L'impact.
+         * @return Hit::object_id pour un triangle de la scène de base, sinon le nombre de ces triangles
+         * plus la place de l'instance dans scene.xml.
+         */
+        static int object(const Hit& hit) noexcept
+        {
+            return (hit.instance < 0) ? hit.object_id
+                                      : static_cast<int>(Scene::triangles.size()) + Scene::instances[hit.instance].rank;
+        }
+        /**
+         * @brief Copie des plans dans une Image, pour l'écrire.
+         * @tparam T Le type d'une valeur, converti en float.
+         * @param[in] planes     Le premier plan, les autres suivant.
+         * @param[in] components Le nombre de plans, 1 (répété sur r, g et b) ou 3.
+         * @param[in] width      La largeur.
+         * @param[in] height     La hauteur.
+         * @return L'image.
+         */
+        template<typename T>
+        static Image toImage(const T* planes, int components, int width, int height)
+        {
+            Image image(width, height);
+            const std::size_t size = static_cast<std::size_t>(width)*height;
+            if (size == 0)
+            {
+                return image;
+            }
+            Color* pixels = &image(0, 0);
+            for(std::size_t i=0;i<size;++i)
+            {
+                const float r = static_cast<float>(planes[i]);
+                pixels[i] = (components == 3)
+                          ? Color(r, static_cast<float>(planes[size + i]), static_cast<float>(planes[2*size + i]))
+                          : Color(r, r, r);
+            }
+            return image;
+        }
+
+        Framebuffer(void)                                   = delete;
+        Framebuffer(const Framebuffer& other)               = delete;
+        Framebuffer& operator=(const Framebuffer& other)    = delete;
+
+    private:
+        /**
+         * @brief Enregistre les AOV géométriques d'un impact : profondeur, normale, objet et albédo.
+         * @param[in] i   L'indice du pixel.
+         * @param[in] hit L'impact du rayon primaire.
+         * @param[in] ray Le rayon primaire.
+         */
+        void geometry(std::size_t i, const Hit& hit, const Ray& ray) noexcept
+        {
+            if (!this->planes[AOV_DEPTH].empty())
+            {
+                this->planes[AOV_DEPTH][i] = hit.t*length(ray.d);
+            }
+            if (!this->planes[AOV_NORMAL].empty())
+            {
+                const Vector n = normalize(hit.n);
+                this->planes[AOV_NORMAL][i]              = n.x;
+                this->planes[AOV_NORMAL][this->size + i]   = n.y;
+                this->planes[AOV_NORMAL][2*this->size + i] = n.z;
+            }
+            if (!this->planes[AOV_OBJECT].empty())
+            {
+                this->planes[AOV_OBJECT][i] = static_cast<float>(object(hit));
+            }
+            if (!this->planes[AOV_ALBEDO].empty())
+            {
+                const ShadingMaterial& material = Scene::triangle_material(hit.object_id);
+                this->color(AOV_ALBEDO, i, material.diffuse + material.specular);
+            }
+        }
+        /**
+         * @brief Enregistre une couleur dans les 3 plans de @b channel, s'ils existent.
+         * @param[in] channel L'AOV.
+         * @param[in] i       L'indice du pixel.
+         * @param[in] value   La couleur.
+         */
+        void color(AovChannel channel, std::size_t i, const Color& value) noexcept
+        {
+            std::vector<float>& plane = this->planes[channel];
+            if (!plane.empty())
+            {
+                plane[i]              = value.r;
+                plane[this->size + i]   = value.g;
+                plane[2*this->size + i] = value.b;
+            }
+        }
+
+        int         width;  //!< La largeur de l'image.
+        int         height; //!< La hauteur de l'image.
+        std::size_t size;   //!< Le nombre de pixels, soit la taille d'un plan.
+        unsigned    mask;   //!< Les AOV activées.
+        std::array<std::vector<float>, AOV_COUNT> planes; //!< Les plans de chaque AOV, vides si elle est désactivée.
+};
+
+
+#endif
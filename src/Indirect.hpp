@@ -1,31 +1,43 @@
 /**
  * @file Indirect.hpp
- * @brief Définit les fonctionnalités pour l'éclairage indirect.
+ * @brief Définit les méthodes pour l'éclairage indirect.
  * @author Laurent BARDOUX p1108365
  * @author Mehdi   GHESH   p1209574
  */
 #ifndef INDIRECT_HPP_INCLUDED
 #define INDIRECT_HPP_INCLUDED
 
-#include <string>
-#include "ray_core.hpp"
-#include "Factory.hpp"
+#include "core/gkit_core.hpp"
+#include "core/ray_core.hpp"
 
+/**
+ * @brief Le nom de PhotonMapping dans raytracing.xml.
+ */
+#define PHOTON_MAPPING_METHOD "PhotonMap"
+
+// Une méthode indirecte fournit, comme une méthode directe, Color compute(observer, impact, N) en statique.
 
-class Indirect
+/**
+ * @struct NoIndirect
+ * @brief Remplace la méthode indirecte lorsque celle-ci est désactivée.
+ */
+struct NoIndirect final
 {
-    public:
-        virtual ~Indirect(void){}
-        virtual Color compute(void) =0;
+    static Color compute(const Point&, const Hit&, int) noexcept
+    {
+        return Color();
+    }
 };
 
-
-class IndirectFactory final : public Factory<std::string, Indirect*>
+/**
+ * @struct PhotonMapping
+ * @brief L'éclairage indirect estimé avec les N photons les plus proches de PhotonMap.
+ * @pre PhotonMap::prepare doit avoir été appelée.
+ */
+struct PhotonMapping final
 {
-    public:
-        IndirectFactory(void);
+    static Color compute(const Point& observer, const Hit& impact, int N);
 };
 
 
 #endif
-
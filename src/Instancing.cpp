@@ -0,0 +1,414 @@
+/**
+ * @file Instancing.cpp
+ */
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "Instancing.hpp"
+#include "ConfigLoaders.hpp"
+#include "Scene.hpp"
+
+namespace
+{
+    /**
+     * @struct LoadedMesh
+     * @brief Ce qu'il faut garder d'un .obj instancié pour recalculer ses matières à chaque scène.
+     */
+    struct LoadedMesh
+    {
+        std::string                 obj;       //!< Le chemin du .obj.
+        int64_t                     size;      //!< La taille du .obj à sa lecture.
+        int64_t                     mtime;     //!< La date de modification du .obj à sa lecture.
+        std::vector<Material>       materials; //!< Ses matières, ajoutées à Scene::materials.
+        std::vector<uint16_t>       local;     //!< La matière de chaque triangle dans @b materials, dans l'ordre du BVH.
+        std::vector<triangle_ind_t> order;     //!< Le triangle du .obj rangé à chaque position du BVH.
+    };
+
+    std::vector<LoadedMesh>     loaded;  //!< Les meshes chargés, dans l'ordre de Scene::meshes.
+    std::vector<InstanceXml>    placed;  //!< Les instances de l'appel précédent à attach().
+    std::vector<triangle_ind_t> slots;   //!< L'instance de @b placed rangée à chaque position de Scene::instances.
+    std::size_t                 appended = 0; //!< Le nombre de sources ajoutées à Scene::sources.
+
+    /**
+     * @brief Compare deux instances de scene.xml.
+     * @param[in] a La première.
+     * @param[in] b La seconde.
+     * @return true si elles placent le meme .obj au meme endroit.
+     */
+    bool same(const InstanceXml& a, const InstanceXml& b)
+    {
+        for(int i=0;i<3;++i)
+        {
+            if (a.translate[i] != b.translate[i] || a.rotate[i] != b.rotate[i] || a.scale[i] != b.scale[i])
+            {
+                return false;
+            }
+        }
+        return a.obj == b.obj;
+    }
+
+    /**
+     * @brief Donne la taille et la date de modification d'un fichier, -1 s'il n'existe pas.
+     * @param[in]  path  Le chemin du fichier.
+     * @param[out] size  Sa taille.
+     * @param[out] mtime Sa date de modification.
+     */
+    void stamp(const std::string& path, int64_t& size, int64_t& mtime)
+    {
+        struct stat info;
+        size  = -1;
+        mtime = -1;
+        if (stat(path.c_str(), &info) == 0)
+        {
+            size  = info.st_size;
+            mtime = info.st_mtime;
+        }
+    }
+
+    /**
+     * @brief Réordonne @b values : la i-ème valeur devient values[order[i]].
+     * @tparam T Le type des valeurs.
+     * @param[in,out] values Les valeurs.
+     * @param[in]     order  La permutation.
+     */
+    template<typename T>
+    void permute(std::vector<T>& values, const std::vector<triangle_ind_t>& order)
+    {
+        std::vector<T> result(order.size());
+        for(std::size_t i=0;i<order.size();++i)
+        {
+            result[i] = values[order[i]];
+        }
+        values.swap(result);
+    }
+
+    /**
+     * @brief Lit les triangles et les matières du .obj d'un mesh.
+     * @param[in,out] entry     Le mesh, dont le .obj est connu.
+     * @param[out]    triangles Ses triangles, dans l'ordre du .obj.
+     * @throw std::invalid_argument Si le .obj n'a aucun triangle.
+     */
+    void read(LoadedMesh& entry, std::vector<Triangle>& triangles)
+    {
+        stamp(entry.obj, entry.size, entry.mtime);
+        const Mesh mesh = read_mesh(entry.obj.c_str());
+        if (mesh.triangle_count() == 0)
+        {
+            throw std::invalid_argument("Instance sans triangle : " + entry.obj);
+        }
+        Scene::convert_triangles(mesh, triangles);
+        entry.materials = mesh.mesh_materials();
+    }
+
+    /**
+     * @brief Calcule la boite de chaque triangle.
+     * @param[in] triangles Les triangles.
+     * @return Leurs boites, dans le meme ordre.
+     */
+    std::vector<BoundingBox> bound(const std::vector<Triangle>& triangles)
+    {
+        std::vector<BoundingBox> boxes(triangles.size());
+        for(std::size_t i=0;i<triangles.size();++i)
+        {
+            boxes[i].insert(triangles[i].a);
+            boxes[i].insert(triangles[i].b);
+            boxes[i].insert(triangles[i].c);
+        }
+        return boxes;
+    }
+
+    /**
+     * @brief Range les triangles du k-ième mesh dans Scene::instanceTriangles, dans l'ordre de son BVH.
+     * @param[in] k         L'indice du mesh.
+     * @param[in] triangles Ses triangles, dans l'ordre du .obj.
+     */
+    void store(std::size_t k, const std::vector<Triangle>& triangles)
+    {
+        LoadedMesh& entry  = loaded[k];
+        Triangle*   stored = Scene::instanceTriangles.data() + Scene::meshes[k].first;
+        entry.local.resize(entry.order.size());
+        for(std::size_t i=0;i<entry.order.size();++i)
+        {
+            entry.local[i] = triangles[entry.order[i]].material;
+            stored[i]      = triangles[entry.order[i]];
+        }
+    }
+
+    /**
+     * @brief Donne le mesh d'un .obj, en le chargeant et en construisant son BVH s'il est nouveau.
+     * @param[in]  obj   Le chemin du .obj.
+     * @param[out] fresh Mis à true si le mesh vient d'etre chargé.
+     * @return L'indice du mesh dans Scene::meshes.
+     * @throw std::invalid_argument Si le .obj n'a aucun triangle.
+     */
+    int load(const std::string& obj, bool& fresh)
+    {
+        for(std::size_t i=0;i<loaded.size();++i)
+        {
+            if (loaded[i].obj == obj)
+            {
+                return i;
+            }
+        }
+        LoadedMesh entry;
+        entry.obj = obj;
+        std::vector<Triangle> triangles;
+        read(entry, triangles);
+        BinaryTree tree;
+        tree.build(bound(triangles), entry.order);
+
+        InstancedMesh instanced;
+        instanced.first = Scene::instanceTriangles.size();
+        instanced.count = triangles.size();
+        Scene::instanceTriangles.resize(Scene::instanceTriangles.size() + triangles.size());
+        Scene::meshes.push_back(instanced);
+        Scene::blas.push_back(std::move(tree));
+        loaded.push_back(std::move(entry));
+        store(loaded.size() - 1, triangles);
+        fresh = true;
+        std::cout << "Mesh instancié " << obj << " : " << instanced.count << " triangles, "
+                  << Scene::blas.back().nodes.size() << " noeuds" << std::endl;
+        return loaded.size() - 1;
+    }
+
+    /**
+     * @brief Relit le k-ième mesh si son .obj a changé depuis sa lecture, et met son BVH à jour.
+     * @details Avec le meme nombre de triangles, le .obj est vu comme le meme mesh déformé : son BVH est
+     * réajusté, et reconstruit seulement si son SAH s'est trop dégradé. Sinon le BVH est reconstruit, et
+     * les triangles des meshes suivants sont décalés dans Scene::instanceTriangles.
+     * @param[in] k L'indice du mesh.
+     * @return true si le mesh a été relu.
+     * @throw std::invalid_argument Si le .obj n'a plus aucun triangle.
+     */
+    bool reload(std::size_t k)
+    {
+        LoadedMesh& entry = loaded[k];
+        int64_t size, mtime;
+        stamp(entry.obj, size, mtime);
+        if (size == entry.size && mtime == entry.mtime)
+        {
+            return false;
+        }
+        std::vector<Triangle> triangles;
+        read(entry, triangles);
+        const std::vector<BoundingBox> boxes = bound(triangles);
+        InstancedMesh& mesh = Scene::meshes[k];
+        BinaryTree&    tree = Scene::blas[k];
+        if (triangles.size() == mesh.count)
+        {
+            std::vector<BoundingBox> stored(boxes.size());
+            for(std::size_t i=0;i<boxes.size();++i)
+            {
+                stored[i] = boxes[entry.order[i]];
+            }
+            std::vector<triangle_ind_t> order;
+            if (tree.update(stored, order, RaytracingXml::bvhRebuild))
+            {
+                permute(entry.order, order);
+                std::cout << "BVH de " << entry.obj << " reconstruit, son SAH réajusté était trop dégradé" << std::endl;
+            }
+            else
+            {
+                std::cout << "BVH de " << entry.obj << " réajusté, SAH à " << tree.degradation()
+                          << " fois celui de sa construction" << std::endl;
+            }
+        }
+        else
+        {
+            const auto end = Scene::instanceTriangles.begin() + mesh.first + mesh.count;
+            if (triangles.size() > mesh.count)
+            {
+                Scene::instanceTriangles.insert(end, triangles.size() - mesh.count, Triangle());
+            }
+            else
+            {
+                Scene::instanceTriangles.erase(end - (mesh.count - triangles.size()), end);
+            }
+            for(std::size_t i=k+1;i<Scene::meshes.size();++i)
+            {
+                Scene::meshes[i].first = Scene::meshes[i].first + triangles.size() - mesh.count;
+            }
+            mesh.count = triangles.size();
+            tree.build(boxes, entry.order);
+            std::cout << "BVH de " << entry.obj << " reconstruit : " << mesh.count << " triangles" << std::endl;
+        }
+        store(k, triangles);
+        return true;
+    }
+
+    /**
+     * @brief Ajoute les matières de chaque mesh à Scene::materials, et renumérote celles de ses triangles.
+     * @throw std::length_error Si la scène a trop de matières pour Triangle::material.
+     */
+    void appendMaterials(void)
+    {
+        for(std::size_t k=0;k<loaded.size();++k)
+        {
+            const std::size_t base = Scene::materials.size();
+            for(const Material& material : loaded[k].materials)
+            {
+                Scene::materials.push_back(ShadingMaterial::build(material, RaytracingXml::interpolation,
+                                                                  RaytracingXml::specularTolerance));
+            }
+            if (loaded[k].materials.empty())
+            {
+                Scene::materials.push_back(ShadingMaterial::build(Material(), RaytracingXml::interpolation,
+                                                                  RaytracingXml::specularTolerance));
+            }
+            if (Scene::materials.size() > std::numeric_limits<uint16_t>::max())
+            {
+                throw std::length_error("Trop de matières pour des indices sur 16 bits");
+            }
+            const InstancedMesh& mesh = Scene::meshes[k];
+            for(unsigned int i=0;i<mesh.count;++i)
+            {
+                Scene::instanceTriangles[mesh.first + i].material = base + loaded[k].local[i];
+            }
+        }
+    }
+
+    /**
+     * @brief Construit une instance de scene.xml : ses transformations et sa boite.
+     * @param[in] xml  L'instance lue.
+     * @param[in] mesh L'indice de son mesh.
+     * @return L'instance.
+     */
+    Instance place(const InstanceXml& xml, int mesh)
+    {
+        Instance instance;
+        instance.mesh     = mesh;
+        instance.toWorld  = Translation(xml.translate[0], xml.translate[1], xml.translate[2])
+                          * RotationZ(xml.rotate[2]) * RotationY(xml.rotate[1]) * RotationX(xml.rotate[0])
+                          * Scale(xml.scale[0], xml.scale[1], xml.scale[2]);
+        instance.toObject = instance.toWorld.inverse();
+        instance.normals  = instance.toWorld.normal();
+        const BoundingBox& local = Scene::blas[mesh].nodes[Scene::blas[mesh].root].bbox;
+        for(int corner=0;corner<8;++corner)
+        {
+            const Point p((corner & 1) ? local.pmax.x : local.pmin.x,
+                          (corner & 2) ? local.pmax.y : local.pmin.y,
+                          (corner & 4) ? local.pmax.z : local.pmin.z);
+            instance.bbox.insert(vec3(instance.toWorld(p)));
+        }
+        return instance;
+    }
+
+    /**
+     * @brief Ajoute à Scene::sources les triangles émissifs de chaque instance, dans le repère de la scène.
+     */
+    void appendSources(void)
+    {
+        const std::size_t before = Scene::sources.size();
+        for(const Instance& instance : Scene::instances)
+        {
+            const InstancedMesh& mesh = Scene::meshes[instance.mesh];
+            for(unsigned int i=mesh.first;i<mesh.first + mesh.count;++i)
+            {
+                const Triangle& triangle = Scene::instanceTriangles[i];
+                const Color&    emission = Scene::materials[triangle.material].emission;
+                if ((emission.r + emission.g + emission.b) > 0)
+                {
+                    Triangle world(triangle);
+                    world.a  = vec3(instance.toWorld(Point(triangle.a)));
+                    world.b  = vec3(instance.toWorld(Point(triangle.b)));
+                    world.c  = vec3(instance.toWorld(Point(triangle.c)));
+                    world.na = vec3(normalize(instance.normals(Vector(triangle.na))));
+                    world.nb = vec3(normalize(instance.normals(Vector(triangle.nb))));
+                    world.nc = vec3(normalize(instance.normals(Vector(triangle.nc))));
+                    Scene::sources.push_back(Source(world, emission));
+                }
+            }
+        }
+        appended = Scene::sources.size() - before;
+    }
+}
+
+
+void Instancing::detach(void)
+{
+    Scene::sources.resize(Scene::sources.size() - appended);
+    appended = 0;
+}
+
+bool Instancing::attach(void)
+{
+    bool changed = SceneXml::instances.size() != placed.size();
+    bool kept    = !changed; // Les memes .obj aux memes places de scene.xml : le BVH des instances peut etre réajusté.
+    std::vector<int>  meshes(SceneXml::instances.size());
+    std::vector<bool> checked(loaded.size(), false);
+    for(std::size_t i=0;i<SceneXml::instances.size();++i)
+    {
+        meshes[i] = load(SceneXml::instances[i].obj, changed);
+        if (static_cast<std::size_t>(meshes[i]) < checked.size() && !checked[meshes[i]])
+        {
+            checked[meshes[i]] = true;
+            changed = reload(meshes[i]) || changed;
+        }
+        // placed a l'ancien nombre d'instances, qui peut etre plus petit.
+        const bool previous = i < placed.size();
+        kept    = kept && previous && SceneXml::instances[i].obj == placed[i].obj;
+        changed = changed || !previous || !same(SceneXml::instances[i], placed[i]);
+    }
+    appendMaterials();
+    if (changed)
+    {
+        std::vector<Instance> instances(SceneXml::instances.size());
+        for(std::size_t i=0;i<instances.size();++i)
+        {
+            instances[i]      = place(SceneXml::instances[i], meshes[i]);
+            instances[i].rank = i;
+        }
+        std::vector<BoundingBox>    boxes(instances.size());
+        std::vector<triangle_ind_t> order;
+        if (kept && !instances.empty())
+        {
+            for(std::size_t i=0;i<slots.size();++i)
+            {
+                boxes[i] = instances[slots[i]].bbox;
+            }
+            if (Scene::tlas.update(boxes, order, RaytracingXml::bvhRebuild))
+            {
+                permute(slots, order);
+            }
+        }
+        else
+        {
+            for(std::size_t i=0;i<instances.size();++i)
+            {
+                boxes[i] = instances[i].bbox;
+            }
+            Scene::tlas.build(boxes, slots);
+        }
+        Scene::instances.clear();
+        for(triangle_ind_t i : slots)
+        {
+            Scene::instances.push_back(instances[i]);
+        }
+        placed = SceneXml::instances;
+        if (!placed.empty())
+        {
+            std::cout << "Nombre d'instances : " << placed.size() << " de " << Scene::meshes.size() << " meshes, "
+                      << Scene::instanceTriangles.size() << " triangles uniques" << std::endl;
+        }
+    }
+    appendSources();
+    return changed;
+}
+
+std::size_t Instancing::footprint(void)
+{
+    std::size_t bytes = Scene::instanceTriangles.size()*sizeof(Triangle) + Scene::meshes.size()*sizeof(InstancedMesh)
+                      + Scene::instances.size()*sizeof(Instance) + Scene::tlas.nodes.size()*sizeof(BinaryTree::Node);
+    for(std::size_t k=0;k<loaded.size();++k)
+    {
+        bytes += Scene::blas[k].nodes.size()*sizeof(BinaryTree::Node)
+               + loaded[k].materials.size()*sizeof(Material) + loaded[k].local.size()*sizeof(uint16_t)
+               + loaded[k].order.size()*sizeof(triangle_ind_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file Instancing.hpp
+ * @brief Les copies de meshes de scene.xml, rangées dans un BVH à deux niveaux.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef INSTANCING_HPP_INCLUDED
+#define INSTANCING_HPP_INCLUDED
+
+#include <cstddef>
+
+
+/**
+ * @class Instancing
+ * @brief Charge chaque .obj instancié une seule fois, avec son BVH dans le repère de l'objet (Scene::blas),
+ * et range ses copies placées dans un BVH au-dessus des instances (Scene::tlas).
+ * @details La mémoire croit avec la géométrie unique, pas avec le nombre de copies : une instance
+ * n'est qu'une transformation et une boite. Les identifiants des triangles instanciés suivent
+ * ceux de Scene::triangles (cf Scene::triangle), et sont partagés par toutes les copies d'un mesh.
+ * Les matières des meshes instanciés sont ajoutées à la fin de Scene::materials, et leurs
+ * triangles émissifs, transformés, à la fin de Scene::sources.
+ * Un .obj réécrit entre deux rendus, par exemple une image d'animation, est relu : les BVH de
+ * son mesh et des instances sont réajustés plutot que reconstruits (cf BinaryTree::update).
+ * Les meshes chargés restent en mémoire d'un rendu à l'autre : ils comptent dans la limite de SceneLibrary,
+ * mais ne sont jamais libérés, toutes les instances de scene.xml étant placées à chaque rendu.
+ */
+class Instancing final
+{
+    public:
+        /**
+         * @brief Retire de Scene::sources les sources ajoutées par attach().
+         * @details À appeler avant SceneLibrary::acquire, qui range les sources de la scène de base.
+         */
+        static void detach(void);
+        /**
+         * @brief Place les instances de SceneXml::instances dans la scène.
+         * @return true si la géométrie des instances a changé depuis l'appel précédent.
+         * @pre Scene::build_materials doit avoir été appelée juste avant, detach() avant la scène de base.
+         * @details Les .obj déjà chargés sont relus s'ils ont changé depuis leur lecture.
+         * @throw std::invalid_argument Si un .obj instancié n'a aucun triangle.
+         * @throw std::length_error     Si la scène a trop de matières pour Triangle::material.
+         */
+        static bool attach(void);
+        /**
+         * @brief Donne la mémoire occupée par les meshes instanciés, leurs BVH et celui des instances.
+         * @return Le nombre d'octets, estimé depuis la taille des tableaux.
+         */
+        static std::size_t footprint(void);
+
+        Instancing(void) = delete;
+};
+
+
+#endif
@@ -0,0 +1,232 @@
+/**
+ * @file IrradianceCache.cpp
+ */
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "IrradianceCache.hpp"
+#include "ConfigLoaders.hpp"
+#include "Scene.hpp"
+#include "structures/SharedLock.hpp"
+
+namespace
+{
+    /**
+     * @struct OctreeNode
+     * @brief Un cube de l'octree et les records qui y sont rangés.
+     */
+    struct OctreeNode
+    {
+        Point                 center;   //!< Le centre du cube.
+        float                 half;     //!< La demi-longueur de son coté.
+        std::array<int, 8>    children; //!< L'indice des fils dans nodes, -1 si absent.
+        std::vector<unsigned> records;  //!< L'indice des records dans records.
+
+        OctreeNode(const Point& center, float half) : center(center), half(half), children(), records()
+        {
+            this->children.fill(-1);
+        }
+    };
+
+    /**
+     * @struct CacheSettings
+     * @brief Ce dont dépendent les records enregistrés.
+     */
+    struct CacheSettings
+    {
+        std::string obj;
+        int         N;
+        float       tweak;
+        float       error;
+        float       minRadius;
+        float       maxRadius;
+
+        bool operator==(const CacheSettings& other) const noexcept
+        {
+            return obj == other.obj && N == other.N && tweak == other.tweak && error == other.error
+                && minRadius == other.minRadius && maxRadius == other.maxRadius;
+        }
+    };
+
+    std::vector<OctreeNode>       nodes;
+    std::vector<IrradianceRecord> records;
+    SharedLock                    lock;     //!< Partagé par les recherches, exclusif pour les modifications.
+    CacheSettings settings  = {std::string(), 0, 0.0f, 0.0f, 0.0f, 0.0f};
+    float         minRadius = 0.0f; //!< Le rayon minimum d'un record, en unités du monde.
+    float         maxRadius = 0.0f; //!< Le rayon maximum d'un record, en unités du monde.
+
+    /**
+     * @brief Donne le cube englobant la scène, racine de l'octree.
+     * @return Le noeud racine, de coté 1 pour une scène vide.
+     */
+    OctreeNode sceneRoot(void)
+    {
+        Point pmin, pmax;
+        if (!Scene::bounds(pmin, pmax))
+        {
+            return OctreeNode(Point(0.0f, 0.0f, 0.0f), 0.5f);
+        }
+        const float half = std::max(std::max(pmax.x - pmin.x, pmax.y - pmin.y), std::max(pmax.z - pmin.z, 1e-6f))/2.0f;
+        return OctreeNode(Point((pmin.x + pmax.x)/2.0f, (pmin.y + pmax.y)/2.0f, (pmin.z + pmax.z)/2.0f), half);
+    }
+
+    /**
+     * @brief Donne l'octant de @b node contenant @b p.
+     * @param[in] node Le noeud.
+     * @param[in] p    Le point.
+     * @return L'indice du fils, de 0 à 7.
+     */
+    inline int octant(const OctreeNode& node, const Point& p) noexcept
+    {
+        return (p.x > node.center.x) | ((p.y > node.center.y) << 1) | ((p.z > node.center.z) << 2);
+    }
+
+    /**
+     * @brief Teste si @b p est dans la boite de @b node agrandie d'un facteur @b scale.
+     * @details Avec un facteur 2, c'est la zone où peuvent influer les records rangés dans ce noeud.
+     * @param[in] node  Le noeud.
+     * @param[in] p     Le point.
+     * @param[in] scale Le facteur appliqué à la demi-longueur du noeud.
+     * @return true si @b p est dans la boite agrandie.
+     */
+    inline bool inside(const OctreeNode& node, const Point& p, float scale) noexcept
+    {
+        const float limit = scale*node.half;
+        return std::abs(p.x - node.center.x) <= limit && std::abs(p.y - node.center.y) <= limit
+            && std::abs(p.z - node.center.z) <= limit;
+    }
+
+    /**
+     * @brief Accumule les records de @b index et de ses fils qui sont valides en @b p.
+     * @param[in]     index      Le noeud à visiter.
+     * @param[in]     p          Le point d'impact.
+     * @param[in]     n          Sa normale, normalisée.
+     * @param[in]     material   Sa matière.
+     * @param[in,out] weights    La somme des poids.
+     * @param[in,out] irradiance La somme pondérée des éclairages.
+     * @param[in,out] visibility La somme pondérée des visibilités.
+     */
+    void gather(int index, const Point& p, const Vector& n, int material,
+                float& weights, float& irradiance, float& visibility) noexcept
+    {
+        const OctreeNode& node = nodes[index];
+        for(unsigned id : node.records)
+        {
+            const IrradianceRecord& record = records[id];
+            if (record.material != material)
+            {
+                continue;
+            }
+            const float error = distance(p, record.p)/record.radius
+                              + std::sqrt(std::max(0.0f, 1.0f - dot(n, record.n)));
+            if (error < settings.error)
+            {
+                const float w = 1.0f/std::max(error, 1e-6f);
+                weights    += w;
+                irradiance += w*record.irradiance;
+                visibility += w*record.visibility;
+            }
+        }
+        for(int child : node.children)
+        {
+            if (child >= 0 && inside(nodes[child], p, 2.0f))
+            {
+                gather(child, p, n, material, weights, irradiance, visibility);
+            }
+        }
+    }
+}
+
+
+void IrradianceCache::prepare(void)
+{
+    const CacheSettings current = {SceneXml::obj, RaytracingXml::directN, RaytracingXml::normalTweak,
+                                   RaytracingXml::irradianceError, RaytracingXml::irradianceMinRadius,
+                                   RaytracingXml::irradianceMaxRadius};
+    if (!(current == settings))
+    {
+        IrradianceCache::clear();
+        settings = current;
+    }
+    std::lock_guard<SharedLock> guard(lock);
+    if (nodes.empty())
+    {
+        nodes.push_back(sceneRoot());
+        const float diagonal = 2.0f*std::sqrt(3.0f)*nodes.front().half;
+        minRadius = settings.minRadius*diagonal;
+        maxRadius = std::max(settings.maxRadius*diagonal, minRadius);
+    }
+}
+
+void IrradianceCache::clear(void)
+{
+    std::lock_guard<SharedLock> guard(lock);
+    nodes.clear();
+    records.clear();
+    settings.obj.clear();
+}
+
+bool IrradianceCache::lookup(const Hit& impact, float& irradiance, float& visibility)
+{
+    const Vector n = normalize(impact.n);
+    const int material = Scene::triangle(impact.object_id).material;
+    float weights = 0.0f, sumIrradiance = 0.0f, sumVisibility = 0.0f;
+    {
+        SharedLock::Reader guard(lock);
+        if (nodes.empty())
+        {
+            return false;
+        }
+        gather(0, impact.p, n, material, weights, sumIrradiance, sumVisibility);
+    }
+    if (weights <= 0.0f)
+    {
+        return false;
+    }
+    irradiance = sumIrradiance/weights;
+    visibility = sumVisibility/weights;
+    return true;
+}
+
+void IrradianceCache::insert(const Hit& impact, float irradiance, unsigned int visible, unsigned int count, float nearest)
+{
+    IrradianceRecord record;
+    record.p          = impact.p;
+    record.n          = normalize(impact.n);
+    record.irradiance = irradiance;
+    record.visibility = (count > 0) ? static_cast<float>(visible)/static_cast<float>(count) : 0.0f;
+    record.material   = Scene::triangle(impact.object_id).material;
+    const bool penumbra = visible > 0 && visible < count;
+    record.radius     = penumbra ? minRadius : std::min(std::max(nearest/2.0f, minRadius), maxRadius);
+
+    // Descend tant que le fils reste plus grand que le rayon d'influence du record,
+    // un record hors de la boite de la scène restant à la racine, toujours visitée.
+    std::lock_guard<SharedLock> guard(lock);
+    if (nodes.empty() || minRadius <= 0.0f)
+    {
+        return;
+    }
+    const float influence = settings.error*record.radius;
+    int index = 0;
+    while(nodes[index].half/2.0f >= influence && inside(nodes[index], record.p, 1.0f))
+    {
+        const int child = octant(nodes[index], record.p);
+        if (nodes[index].children[child] < 0)
+        {
+            const OctreeNode& parent = nodes[index];
+            const float half = parent.half/2.0f;
+            const Point center(parent.center.x + ((child & 1) ? half : -half),
+                               parent.center.y + ((child & 2) ? half : -half),
+                               parent.center.z + ((child & 4) ? half : -half));
+            nodes[index].children[child] = nodes.size();
+            nodes.push_back(OctreeNode(center, half));
+        }
+        index = nodes[index].children[child];
+    }
+    nodes[index].records.push_back(records.size());
+    records.push_back(record);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file IrradianceCache.hpp
+ * @brief Calcule l'éclairage diffus en quelques points épars, puis l'interpole entre eux.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef IRRADIANCECACHE_HPP_INCLUDED
+#define IRRADIANCECACHE_HPP_INCLUDED
+
+#include "core/gkit_core.hpp"
+#include "Scene.hpp"
+
+/**
+ * @struct IrradianceRecord
+ * @brief Un point où l'éclairage a réellement été calculé.
+ */
+struct IrradianceRecord final
+{
+    Point p;          //!< Le point d'impact, avant décalage.
+    Vector n;         //!< Sa normale, normalisée.
+    float irradiance; //!< L'éclairage diffus reçu pour un albédo de 1, déjà normalisé par le nombre d'échantillons.
+    float visibility; //!< La part des échantillons des sources non occultés.
+    float radius;     //!< Le rayon de validité, en unités du monde.
+    int   material;   //!< La matière du triangle touché.
+};
+
+/**
+ * @class IrradianceCache
+ * @brief Les records de l'éclairage diffus, rangés dans un octree sur la boite englobante de la scène.
+ * @details Un point est interpolé à partir des records dont le poids de Ward
+ * w = 1/(|p - pi|/Ri + sqrt(1 - n.ni)) dépasse 1/error, error étant RaytracingXml::irradianceError.
+ * Chaque record est rangé dans le plus petit noeud plus grand que son rayon d'influence error*Ri,
+ * une recherche ne visite donc que les noeuds dont la boite élargie de moitié contient le point.
+ * L'éclairage diffus ne dépend pas du point de vue : les records restent valides d'une image
+ * à l'autre tant que la scène et l'échantillonnage ne changent pas.
+ */
+class IrradianceCache final
+{
+    public:
+        /**
+         * @brief Prépare le cache pour le prochain rendu, en le vidant si ce qui détermine l'éclairage a changé.
+         * @details Compare le .obj, N, le décalage des normales et les réglages du cache.
+         * @pre La scène doit etre chargée et la configuration lue.
+         */
+        static void prepare(void);
+        /**
+         * @brief Vide le cache, par exemple quand la scène vient d'etre (re)chargée.
+         */
+        static void clear(void);
+        /**
+         * @brief Interpole l'éclairage en @b impact à partir des records voisins.
+         * @param[in]  impact     Le point d'impact.
+         * @param[out] irradiance L'éclairage diffus interpolé, pour un albédo de 1.
+         * @param[out] visibility La part interpolée des échantillons non occultés.
+         * @return false si aucun record n'est assez proche, @b irradiance et @b visibility sont alors inchangés.
+         * @note Peut etre appelée depuis plusieurs threads à la fois.
+         */
+        static bool lookup(const Hit& impact, float& irradiance, float& visibility);
+        /**
+         * @brief Ajoute un record, dont le rayon est déduit de la distance aux sources et de la visibilité.
+         * @param[in] impact     Le point d'impact où l'éclairage a été calculé.
+         * @param[in] irradiance L'éclairage diffus calculé, pour un albédo de 1.
+         * @param[in] visible    Le nombre d'échantillons non occultés.
+         * @param[in] count      Le nombre d'échantillons tirés.
+         * @param[in] nearest    La distance à l'échantillon de source le plus proche.
+         * @details Un record en pénombre (visibilité partielle) garde le rayon minimum,
+         * les autres prennent la moitié de @b nearest, borné par les rayons minimum et maximum.
+         * @note Peut etre appelée depuis plusieurs threads à la fois.
+         */
+        static void insert(const Hit& impact, float irradiance, unsigned int visible, unsigned int count, float nearest);
+
+        IrradianceCache(void) = delete;
+};
+
+
+#endif
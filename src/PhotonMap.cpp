@@ -0,0 +1,328 @@
+/**
+ * @file PhotonMap.cpp
+ */
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PhotonMap.hpp"
+#include "Indirect.hpp"
+#include "ConfigLoaders.hpp"
+#include "Scene.hpp"
+#include "core/time_core.hpp"
+#include "structures/Photon.hpp"
+#include "structures/World.hpp"
+
+namespace
+{
+    /**
+     * @struct MapSettings
+     * @brief Ce dont dépendent les photons émis.
+     */
+    struct MapSettings
+    {
+        std::string obj;
+        int         photons;
+        int         seed;
+        float       coef;
+        float       tweak;
+
+        bool operator==(const MapSettings& other) const noexcept
+        {
+            return obj == other.obj && photons == other.photons && seed == other.seed
+                && coef == other.coef && tweak == other.tweak;
+        }
+    };
+
+    typedef std::pair<float, unsigned> Neighbour; //!< La distance au carré d'un photon, et son indice.
+
+    std::vector<Photon> photons;
+    MapSettings settings    = {std::string(), 0, 0, 0.0f, 0.0f};
+    float       maxDistance2 = 0.0f; //!< Le carré du rayon maximum d'une estimation, en unités du monde.
+
+    /**
+     * @brief Tire une direction en cosinus autour de @b n.
+     * @param[in] n  La normale, normalisée.
+     * @param[in] u1 Un nombre uniforme dans [0, 1).
+     * @param[in] u2 Un nombre uniforme dans [0, 1).
+     * @return La direction, dans l'hémisphère de @b n.
+     */
+    Vector cosineDirection(const Vector& n, float u1, float u2) noexcept
+    {
+        const float r   = std::sqrt(u1);
+        const float phi = 2.0f*M_PI*u2;
+        return World(n)(Vector(r*std::cos(phi), r*std::sin(phi), std::sqrt(std::max(0.0f, 1.0f - u1))));
+    }
+
+    /**
+     * @brief Suit un photon depuis sa source, et dépose ses impacts après le premier rebond.
+     * @param[in]     index Le numéro du photon, qui choisit sa source.
+     * @param[in]     flux  Le flux du photon à l'émission.
+     * @param[in,out] mt    Le générateur du paquet de photons courant.
+     * @param[out]    out   Les photons déposés.
+     */
+    void emit(int index, const Color& flux, std::mt19937& mt, std::vector<Photon>& out)
+    {
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+        const Source& src = Scene::sources[index % Scene::sources.size()];
+        const float sqrt_u = std::sqrt(dist(mt));
+        const float beta   = dist(mt)*sqrt_u;
+        const float alpha  = sqrt_u - beta;
+        Vector n     = normalize(src.normal(alpha, beta));
+        Point  p     = src.point(alpha, beta) + n*RaytracingXml::normalTweak;
+        Vector d     = cosineDirection(n, dist(mt), dist(mt));
+        Color  power = flux;
+        for(int bounce=0;bounce<PHOTON_MAX_BOUNCES;++bounce)
+        {
+            Hit hit;
+            if (!Scene::intersect(Ray(p, d), hit))
+            {
+                return;
+            }
+            n = normalize(hit.n);
+            if (dot(n, d) > 0.0f)
+            {
+                n = -n;
+            }
+            if (bounce > 0)
+            {
+                out.push_back(Photon::make(hit.p, n, power));
+            }
+            // Roulette russe sur l'albédo : un photon qui survit emporte le flux des autres.
+            const Color& albedo  = Scene::triangle_material(hit.object_id).diffuse;
+            const float survival = std::min(1.0f, std::max(albedo.r, std::max(albedo.g, albedo.b)));
+            if (survival <= 0.0f || dist(mt) >= survival)
+            {
+                return;
+            }
+            power = power*albedo/survival;
+            p     = hit.p + n*RaytracingXml::normalTweak;
+            d     = cosineDirection(n, dist(mt), dist(mt));
+        }
+    }
+
+    /**
+     * @brief Range [begin, end) en kd-tree implicite, coupé selon le plus grand axe de chaque intervalle.
+     * @param[in] begin Le premier photon de l'intervalle.
+     * @param[in] end   Le photon suivant le dernier.
+     */
+    void build(unsigned begin, unsigned end)
+    {
+        if (end - begin < 2)
+        {
+            return;
+        }
+        Point pmin(photons[begin].position), pmax(pmin);
+        for(unsigned i=begin+1;i<end;++i)
+        {
+            const Point& p = photons[i].position;
+            pmin = Point(std::min(pmin.x, p.x), std::min(pmin.y, p.y), std::min(pmin.z, p.z));
+            pmax = Point(std::max(pmax.x, p.x), std::max(pmax.y, p.y), std::max(pmax.z, p.z));
+        }
+        const Vector extent(pmin, pmax);
+        const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+        const unsigned median = begin + (end - begin)/2;
+        std::nth_element(photons.begin() + begin, photons.begin() + median, photons.begin() + end,
+                         [axis](const Photon& a, const Photon& b){
+                             return a.coordinate(axis) < b.coordinate(axis);
+                         });
+        photons[median].axis = axis;
+        // Les deux moitiés sont indépendantes : les grandes sont construites en parallèle.
+        #pragma omp task if (end - begin > PHOTON_CHUNK)
+        build(begin, median);
+        #pragma omp task if (end - begin > PHOTON_CHUNK)
+        build(median + 1, end);
+        #pragma omp taskwait
+    }
+
+    /**
+     * @brief Cherche les photons les plus proches de @b p dans [begin, end).
+     * @param[in]     begin   Le premier photon de l'intervalle.
+     * @param[in]     end     Le photon suivant le dernier.
+     * @param[in]     p       Le point d'estimation.
+     * @param[in]     n       Sa normale, normalisée.
+     * @param[in]     k       Le nombre de photons voulus.
+     * @param[in,out] heap    Un tas des photons trouvés, le plus éloigné en tete.
+     * @param[in,out] radius2 Le carré de la distance de recherche, réduit une fois le tas plein.
+     */
+    void nearest(unsigned begin, unsigned end, const Point& p, const Vector& n, unsigned k,
+                 std::vector<Neighbour>& heap, float& radius2)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+        const unsigned median = begin + (end - begin)/2;
+        const Photon& photon = photons[median];
+        const float delta = ((photon.axis == 0) ? p.x : ((photon.axis == 1) ? p.y : p.z))
+                          - photon.coordinate(photon.axis);
+        // Le coté du point d'abord, l'autre seulement si la sphère de recherche le traverse.
+        if (delta < 0.0f)
+        {
+            nearest(begin, median, p, n, k, heap, radius2);
+        }
+        else
+        {
+            nearest(median + 1, end, p, n, k, heap, radius2);
+        }
+        const float d2 = distance2(p, photon.position);
+        if (d2 < radius2 && photon.facing(n) >= PHOTON_MIN_FACING)
+        {
+            if (heap.size() == k)
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+            heap.push_back(Neighbour(d2, median));
+            std::push_heap(heap.begin(), heap.end());
+            if (heap.size() == k)
+            {
+                radius2 = heap.front().first;
+            }
+        }
+        if (delta*delta < radius2)
+        {
+            if (delta < 0.0f)
+            {
+                nearest(median + 1, end, p, n, k, heap, radius2);
+            }
+            else
+            {
+                nearest(begin, median, p, n, k, heap, radius2);
+            }
+        }
+    }
+
+    /**
+     * @brief Donne la diagonale de la boite englobante de la scène.
+     * @return La longueur de la diagonale, 1 pour une scène vide.
+     */
+    float sceneDiagonal(void)
+    {
+        Point pmin, pmax;
+        if (!Scene::bounds(pmin, pmax))
+        {
+            return 1.0f;
+        }
+        return std::max(distance(pmin, pmax), 1e-6f);
+    }
+}
+
+
+void PhotonMap::prepare(void)
+{
+    if (!RaytracingXml::indirectEnabled || RaytracingXml::indirectMethod != PHOTON_MAPPING_METHOD)
+    {
+        return;
+    }
+    const float radius = RaytracingXml::photonRadius*sceneDiagonal();
+    maxDistance2 = radius*radius;
+    const MapSettings current = {SceneXml::obj, RaytracingXml::photonCount, RaytracingXml::seed,
+                                 RaytracingXml::interpolation, RaytracingXml::normalTweak};
+    if (current == settings)
+    {
+        return;
+    }
+    PhotonMap::clear();
+    settings = current;
+    if (Scene::sources.empty() || current.photons <= 0)
+    {
+        return;
+    }
+
+    timeBeginFunc("Emission des photons");
+    // Direct revient à une source lambertienne blanche de flux pi*pi, que ses échantillons moyennent
+    // avec ceux des autres sources sans tenir compte de leur aire : le flux total est donc pi*pi,
+    // partagé également entre les sources (cf emit).
+    const int   emitted = current.photons;
+    const Color flux    = Color(1.0f, 1.0f, 1.0f, 0.0f)*static_cast<float>(M_PI*M_PI/emitted);
+    const int   chunks  = (emitted + PHOTON_CHUNK - 1)/PHOTON_CHUNK;
+    std::vector<std::vector<Photon>> stored(chunks);
+    #pragma omp parallel for schedule(dynamic)
+    for(int chunk=0;chunk<chunks;++chunk)
+    {
+        std::seed_seq seed = {current.seed, chunk};
+        std::mt19937  mt(seed);
+        const int last = std::min(emitted, (chunk + 1)*PHOTON_CHUNK);
+        for(int i=chunk*PHOTON_CHUNK;i<last;++i)
+        {
+            emit(i, flux, mt, stored[chunk]);
+        }
+    }
+    std::size_t total = 0;
+    for(const std::vector<Photon>& part : stored)
+    {
+        total += part.size();
+    }
+    photons.reserve(total);
+    for(std::vector<Photon>& part : stored)
+    {
+        photons.insert(photons.end(), part.begin(), part.end());
+        std::vector<Photon>().swap(part);
+    }
+    #pragma omp parallel
+    {
+        #pragma omp single
+        build(0, photons.size());
+    }
+    timeEndFunc();
+    timePrint();
+
+    const double megabytes = photons.capacity()*sizeof(Photon)/(1024.0*1024.0);
+    std::cout << "Carte de photons : " << photons.size() << " photons gardés pour " << emitted << " émis, "
+              << megabytes << " Mo";
+    if (!photons.empty())
+    {
+        std::cout << ", soit " << megabytes/(photons.size()*1e-6) << " Mo par million de photons";
+    }
+    std::cout << std::endl;
+}
+
+void PhotonMap::clear(void)
+{
+    std::vector<Photon>().swap(photons);
+    settings.obj.clear();
+}
+
+Color PhotonMap::gather(const Hit& impact, int k)
+{
+    if (photons.empty() || k <= 0)
+    {
+        return Color();
+    }
+    thread_local std::vector<Neighbour> heap;
+    heap.clear();
+    float radius2 = maxDistance2;
+    const Vector n = normalize(impact.n);
+    nearest(0, photons.size(), impact.p, n, k, heap, radius2);
+    if (heap.empty())
+    {
+        return Color();
+    }
+    // Estimation de densité sur le disque contenant les k photons : L = albedo/pi * somme(flux)/(pi*r²).
+    float power[3] = {0.0f, 0.0f, 0.0f};
+    for(const Neighbour& neighbour : heap)
+    {
+        const Photon& photon = photons[neighbour.second];
+        power[0] += photon.power[0];
+        power[1] += photon.power[1];
+        power[2] += photon.power[2];
+    }
+    const float area = static_cast<float>(M_PI*M_PI)*radius2;
+    return Scene::triangle_material(impact.object_id).diffuse*Color(power[0], power[1], power[2], 0.0f)/area;
+}
+
+std::size_t PhotonMap::size(void) noexcept
+{
+    return photons.size();
+}
+
+Color PhotonMapping::compute(const Point& observer, const Hit& impact, int N)
+{
+    (void)observer;
+    return PhotonMap::gather(impact, N);
+}
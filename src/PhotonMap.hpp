@@ -0,0 +1,74 @@
+/**
+ * @file PhotonMap.hpp
+ * @brief L'éclairage indirect par carte de photons.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef PHOTONMAP_HPP_INCLUDED
+#define PHOTONMAP_HPP_INCLUDED
+
+#include <cstddef>
+
+#include "core/gkit_core.hpp"
+#include "Scene.hpp"
+
+/**
+ * @brief Le nombre de photons émis avec une meme graine, pour que la carte ne dépende pas du nombre de threads.
+ */
+#define PHOTON_CHUNK 4096
+/**
+ * @brief Le nombre maximum de rebonds d'un photon, la roulette russe l'arretant en général avant.
+ */
+#define PHOTON_MAX_BOUNCES 8
+/**
+ * @brief Le cosinus minimum entre la normale d'un photon et celle du point où on l'estime.
+ */
+#define PHOTON_MIN_FACING 0.7f
+
+/**
+ * @class PhotonMap
+ * @brief Les photons issus de Scene::sources, rangés dans un kd-tree équilibré.
+ * @details Les photons sont émis en parallèle depuis les sources, avec une direction en cosinus,
+ * puis rebondissent de façon diffuse selon l'albédo des surfaces. Seuls les impacts après au moins
+ * un rebond sont gardés : l'éclairage direct reste calculé par la méthode directe.
+ *
+ * Le kd-tree est implicite : le tableau est trié de sorte que le photon médian de chaque intervalle
+ * en soit le noeud, ses deux moitiés étant les fils. Il n'y a donc aucun pointeur, et une recherche
+ * parcourt des photons contigus.
+ *
+ * Comme pour Direct, chaque source reçoit le meme flux, de sorte que l'éclairage indirect
+ * reste à l'échelle de l'éclairage direct.
+ */
+class PhotonMap final
+{
+    public:
+        /**
+         * @brief Émet les photons et construit le kd-tree, si ce qui les détermine a changé.
+         * @details Compare le .obj, le nombre de photons, la graine, le coefficient de Blinn-Phong
+         * et le décalage des normales. Affiche la mémoire utilisée.
+         * @pre La scène doit etre chargée et la configuration lue.
+         */
+        static void prepare(void);
+        /**
+         * @brief Libère les photons, par exemple quand la scène vient d'etre (re)chargée.
+         */
+        static void clear(void);
+        /**
+         * @brief Estime la luminance indirecte en @b impact à partir des @b k photons les plus proches.
+         * @param[in] impact Le point d'impact.
+         * @param[in] k      Le nombre de photons de l'estimation.
+         * @return La luminance réfléchie, nulle s'il n'y a aucun photon à portée.
+         * @note Peut etre appelée depuis plusieurs threads à la fois, une fois prepare() terminée.
+         */
+        static Color gather(const Hit& impact, int k);
+        /**
+         * @brief Le nombre de photons dans la carte.
+         * @return Le nombre de photons stockés.
+         */
+        static std::size_t size(void) noexcept;
+
+        PhotonMap(void) = delete;
+};
+
+
+#endif
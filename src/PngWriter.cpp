@@ -0,0 +1,231 @@
+/**
+ * @file PngWriter.cpp
+ */
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#ifdef USE_ZLIB
+    #include <zlib.h>
+#endif
+
+#include "PngWriter.hpp"
+
+#define PNG_STRIP_ROWS 16
+
+namespace
+{
+    /**
+     * @brief Convertit une composante comme write_image le fait.
+     * @param[in] value La composante, déjà tonemappée.
+     * @return La valeur sur 8 bits.
+     */
+    inline unsigned char quantize(float value) noexcept
+    {
+        return static_cast<unsigned char>(std::min(std::max(std::floor(value*255.0f), 0.0f), 255.0f));
+    }
+
+    /**
+     * @brief Écrit @b value en big endian dans @b out.
+     * @param[out] out   Les 4 octets de destination.
+     * @param[in]  value La valeur à écrire.
+     */
+    inline void bigEndian(unsigned char* out, unsigned long value) noexcept
+    {
+        out[0] = static_cast<unsigned char>((value >> 24) & 0xff);
+        out[1] = static_cast<unsigned char>((value >> 16) & 0xff);
+        out[2] = static_cast<unsigned char>((value >>  8) & 0xff);
+        out[3] = static_cast<unsigned char>( value        & 0xff);
+    }
+}
+
+
+PngWriter::PngWriter(const std::string& filename, int width, int height)
+    : filename(filename), file(nullptr), width(width), height(height), next(0), adler(1), failed(false),
+      pending(), lock(), buffer()
+{
+#ifdef USE_ZLIB
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    this->file = std::fopen(filename.c_str(), "wb");
+    if (this->file == nullptr)
+    {
+        this->failed = true;
+        return;
+    }
+    std::fwrite(signature, 1, sizeof(signature), this->file);
+    unsigned char header[13];
+    bigEndian(header,   width);
+    bigEndian(header+4, height);
+    header[8]  = 8; // 8 bits par composante
+    header[9]  = 6; // RGBA
+    header[10] = 0; // deflate
+    header[11] = 0; // filtrage adaptatif par ligne
+    header[12] = 0; // non entrelacé
+    this->chunk("IHDR", header, sizeof(header));
+    // Entete zlib, le flux deflate est la concaténation des bandes.
+    const unsigned char zlibHeader[2] = {0x78, 0x9c};
+    this->chunk("IDAT", zlibHeader, sizeof(zlibHeader));
+#else
+    this->buffer = Image(width, height);
+#endif
+}
+
+PngWriter::~PngWriter(void) noexcept
+{
+    if (this->file != nullptr)
+    {
+        std::fclose(this->file);
+    }
+}
+
+void PngWriter::rows(const Color* pixels, int y0, int y1)
+{
+    if (y1 <= y0)
+    {
+        return;
+    }
+#ifdef USE_ZLIB
+    // Les lignes du .png vont du haut vers le bas, celles de Image du bas vers le haut.
+    const int first  = this->height - y1;
+    const int stride = 1 + 4*this->width;
+    std::vector<unsigned char> raw(stride*(y1 - y0));
+    for(int y=y1-1;y>=y0;--y)
+    {
+        unsigned char* line = raw.data() + (y1-1 - y)*stride;
+        unsigned char* rgba = line + 1;
+        const Color*   row  = pixels + static_cast<std::size_t>(y - y0)*this->width;
+        for(int x=0;x<this->width;++x)
+        {
+            const Color color = row[x];
+            rgba[4*x]   = quantize(color.r);
+            rgba[4*x+1] = quantize(color.g);
+            rgba[4*x+2] = quantize(color.b);
+            rgba[4*x+3] = quantize(color.a);
+        }
+        // Filtre Sub : il ne dépend que de la ligne elle-meme, les bandes restent indépendantes.
+        line[0] = 1;
+        for(int i=4*this->width-1;i>=4;--i)
+        {
+            rgba[i] = static_cast<unsigned char>(rgba[i] - rgba[i-4]);
+        }
+    }
+
+    Segment segment;
+    segment.length = raw.size();
+    segment.rows   = y1 - y0;
+    segment.adler  = adler32(adler32(0L, Z_NULL, 0), raw.data(), raw.size());
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree  = Z_NULL;
+    stream.opaque = Z_NULL;
+    // deflate brut (sans entete), fermé seulement par la dernière bande du fichier.
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->failed = true;
+        return;
+    }
+    segment.data.resize(deflateBound(&stream, raw.size()) + 16);
+    stream.next_in   = raw.data();
+    stream.avail_in  = raw.size();
+    stream.next_out  = segment.data.data();
+    stream.avail_out = segment.data.size();
+    const bool last  = (y0 == 0);
+    const int  code  = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    segment.data.resize(segment.data.size() - stream.avail_out);
+    deflateEnd(&stream);
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (code != (last ? Z_STREAM_END : Z_OK) || stream.avail_in != 0)
+    {
+        this->failed = true;
+        return;
+    }
+    this->pending[first] = std::move(segment);
+    // Écrit toutes les bandes contigues à ce qui est déjà dans le fichier.
+    auto it = this->pending.find(this->next);
+    while(it != this->pending.end())
+    {
+        this->chunk("IDAT", it->second.data.data(), it->second.data.size());
+        this->adler = adler32_combine(this->adler, it->second.adler, it->second.length);
+        this->next += it->second.rows;
+        this->pending.erase(it);
+        it = this->pending.find(this->next);
+    }
+#else
+    std::lock_guard<std::mutex> guard(this->lock);
+    for(int y=y0;y<y1;++y)
+    {
+        const Color* row = pixels + static_cast<std::size_t>(y - y0)*this->width;
+        for(int x=0;x<this->width;++x)
+        {
+            this->buffer(x, y) = row[x];
+        }
+    }
+    this->next += y1 - y0;
+#endif
+}
+
+bool PngWriter::close(void)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->next != this->height)
+    {
+        this->failed = true;
+    }
+#ifdef USE_ZLIB
+    if (this->file == nullptr)
+    {
+        return false;
+    }
+    if (!this->failed)
+    {
+        unsigned char trailer[4];
+        bigEndian(trailer, this->adler);
+        this->chunk("IDAT", trailer, sizeof(trailer));
+        this->chunk("IEND", nullptr, 0);
+    }
+    this->failed = (std::fclose(this->file) != 0) || this->failed;
+    this->file   = nullptr;
+#else
+    this->failed = this->failed || (write_image(this->buffer, this->filename.c_str()) != 0);
+#endif
+    if (this->failed)
+    {
+        std::cerr << "[error] writing png image '" << this->filename << "'..." << std::endl;
+    }
+    return !this->failed;
+}
+
+bool PngWriter::write(const Image& image, const std::string& filename)
+{
+    PngWriter writer(filename, image.width(), image.height());
+    const int strips = (image.height() + PNG_STRIP_ROWS - 1)/PNG_STRIP_ROWS;
+    #pragma omp parallel for schedule(dynamic)
+    for(int strip=0;strip<strips;++strip)
+    {
+        const int y0 = strip*PNG_STRIP_ROWS;
+        const Color* pixels = static_cast<const Color*>(image.buffer()) + static_cast<std::size_t>(y0)*image.width();
+        writer.rows(pixels, y0, std::min(y0 + PNG_STRIP_ROWS, image.height()));
+    }
+    return writer.close();
+}
+
+#ifdef USE_ZLIB
+void PngWriter::chunk(const char* type, const unsigned char* data, std::size_t size)
+{
+    unsigned char length[4], crc[4];
+    bigEndian(length, size);
+    unsigned long sum = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+    if (size > 0)
+    {
+        sum = crc32(sum, data, size);
+    }
+    bigEndian(crc, sum);
+    const bool ok = std::fwrite(length, 1, 4, this->file) == 4
+                 && std::fwrite(type, 1, 4, this->file) == 4
+                 && (size == 0 || std::fwrite(data, 1, size, this->file) == size)
+                 && std::fwrite(crc, 1, 4, this->file) == 4;
+    this->failed = this->failed || !ok;
+}
+#endif
@@ -0,0 +1,100 @@
+/**
+ * @file PngWriter.hpp
+ * @brief Un encodeur .png par bandes, compressées en parallèle et écrites dès qu'elles sont prêtes.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef PNGWRITER_HPP_INCLUDED
+#define PNGWRITER_HPP_INCLUDED
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "core/gkit_core.hpp"
+
+
+/**
+ * @class PngWriter
+ * @brief Écrit une image RGBA8 bande par bande, dans n'importe quel ordre.
+ * @details Chaque bande est filtrée puis compressée seule en un bloc deflate indépendant,
+ * par le thread qui la soumet. Les bandes sont ensuite écrites dans l'ordre du fichier
+ * dès que toutes celles qui les précèdent sont arrivées, et les flux sont joints en un seul flux zlib.
+ * Sans USE_ZLIB, les bandes sont gardées en mémoire et close() se rabat sur write_image.
+ */
+class PngWriter final
+{
+    public:
+        /**
+         * @brief Ouvre le fichier et écrit l'entete du .png.
+         * @param[in] filename Le nom du fichier à écrire.
+         * @param[in] width    La largeur de l'image.
+         * @param[in] height   La hauteur de l'image.
+         */
+        PngWriter(const std::string& filename, int width, int height);
+        /**
+         * @brief Ferme le fichier s'il ne l'a pas été, le .png est alors incomplet.
+         */
+        ~PngWriter(void) noexcept;
+        /**
+         * @brief Compresse les lignes [y0, y1) et écrit tout ce qui peut l'etre.
+         * @param[in] pixels Les lignes, déjà tonemappées, la ligne y commençant à pixels + (y - y0)*width.
+         * @param[in] y0     La première ligne de la bande (repère de Image, y vers le haut).
+         * @param[in] y1     La ligne suivant la dernière de la bande.
+         * @note Peut etre appelée depuis plusieurs threads à la fois, chaque ligne une seule fois.
+         */
+        void rows(const Color* pixels, int y0, int y1);
+        /**
+         * @brief Termine le fichier.
+         * @return true si toutes les lignes ont été reçues et écrites, false sinon.
+         */
+        bool close(void);
+        /**
+         * @brief Écrit toute une image, en compressant ses bandes en parallèle.
+         * @param[in] image    L'image à écrire, déjà tonemappée.
+         * @param[in] filename Le nom du fichier.
+         * @return true si l'écriture a réussi, false sinon.
+         */
+        static bool write(const Image& image, const std::string& filename);
+
+        PngWriter(void)                                 = delete;
+        PngWriter(const PngWriter& other)               = delete;
+        PngWriter& operator=(const PngWriter& other)    = delete;
+
+    private:
+        /**
+         * @struct Segment
+         * @brief Une bande compressée qui attend que les précédentes soient écrites.
+         */
+        struct Segment
+        {
+            std::vector<unsigned char> data;   //!< Le bloc deflate brut.
+            unsigned long              adler;  //!< L'adler32 des octets non compressés.
+            unsigned long              length; //!< Le nombre d'octets non compressés.
+            int                        rows;   //!< Le nombre de lignes de la bande.
+        };
+
+        std::string            filename; //!< Le nom du fichier.
+        std::FILE*             file;     //!< Le fichier en cours d'écriture.
+        int                    width;    //!< La largeur de l'image.
+        int                    height;   //!< La hauteur de l'image.
+        int                    next;     //!< La prochaine ligne du .png (de haut en bas) à écrire.
+        unsigned long          adler;    //!< L'adler32 de tout ce qui a été écrit.
+        bool                   failed;   //!< Si une écriture a échoué.
+        std::map<int, Segment> pending;  //!< Les bandes prêtes, par première ligne du .png.
+        std::mutex             lock;     //!< Protège tout ce qui précède.
+        Image                  buffer;   //!< Les lignes reçues, utilisé seulement sans USE_ZLIB.
+
+        /**
+         * @brief Écrit un chunk complet, avec sa taille et son crc.
+         * @param[in] type Le type du chunk, sur 4 caractères.
+         * @param[in] data Le contenu du chunk.
+         * @param[in] size La taille du contenu.
+         */
+        void chunk(const char* type, const unsigned char* data, std::size_t size);
+};
+
+
+#endif
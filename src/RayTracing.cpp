@@ -1,114 +1,303 @@
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "core/gkit_core.hpp"
 #include "core/ray_core.hpp"
 #include "core/time_core.hpp"
+#include "Checkpoint.hpp"
 #include "ConfigLoaders.hpp"
+#include "Denoiser.hpp"
 #include "Direct.hpp"
+#include "Distributed.hpp"
+#include "Framebuffer.hpp"
+#include "Indirect.hpp"
+#include "Instancing.hpp"
+#include "IrradianceCache.hpp"
+#include "PhotonMap.hpp"
+#include "PngWriter.hpp"
+#include "Render.hpp"
+#include "RenderServer.hpp"
+#include "SceneLibrary.hpp"
 #include "tonemapper.hpp"
+#include "VisibilityCache.hpp"
 
 /**
  * @brief Crée le point d'origine de tous les rayons.
- * @param[in]     image L'image dans laquelle on va écrire le résultat.
+ * @param[in]     frame Le tampon dans lequel on va écrire le résultat.
  * @param[in,out] o     Le point résultat.
  * @return o
  */
-Point& createNearPoint(const Image& image, Point& o, Point& d0, Vector& dx0, Vector& dy0)
+Point& createNearPoint(const TileBuffer& frame, Point& o, Point& d0, Vector& dx0, Vector& dy0)
 {
-    Scene::camera.frame(image.width(), image.height(), 1, ImageXml::fov, d0, dx0, dy0);
+    Scene::camera.frame(frame.width, frame.height, 1, ImageXml::fov, d0, dx0, dy0);
     o = Scene::camera.position();
     return o;
 }
 
+/**
+ * @brief Construit le nom d'une sortie de l'image à partir de son nom en .png.
+ * @param[in] name      Le nom du .png, ImageXml::outputName au moment du rendu.
+ * @param[in] extension La nouvelle extension, avec son point.
+ * @return Le nom de la sortie, qui ne diffère du .png que par l'extension.
+ */
+std::string outputFile(const std::string& name, const std::string& extension)
+{
+    return name.substr(0, name.rfind(".png")) + extension;
+}
+
 /**
  * @brief Utilise les fichiers xml pour configurer la scène.
  * @pre loadXMLs doit avoir été appelé au préalable.
  */
 void initializeScene(void)
 {
-    Scene::mesh = read_mesh(SceneXml::obj.c_str());
+    Instancing::detach();
+    const bool loaded = !SceneLibrary::acquire(SceneXml::obj);
+    Scene::build_materials(RaytracingXml::interpolation, RaytracingXml::specularTolerance);
+    if (Instancing::attach() || loaded)
+    {
+        VisibilityCache::clear();
+        IrradianceCache::clear();
+        PhotonMap::clear();
+    }
     Scene::camera.read_orbiter(SceneXml::orbiter.c_str());
-    Scene::build_triangles();
-    Scene::build_sources();
+    if (SceneXml::turntableFrames > 0)
+    {
+        Scene::camera.rotation(SceneXml::turntableDegrees*SceneXml::frame/SceneXml::turntableFrames, 0.0f);
+    }
+    VisibilityCache::prepare();
+    IrradianceCache::prepare();
+    PhotonMap::prepare();
 }
 
 /**
- * @brief Applique un tonemappage en effectuant les conversions nécessaires.
- * @param[in] initial La couleur avant tonemapping
- * @return La nouvelle couleur compressée.
+ * @brief Choisit le noyau de rendu en fonction des paramètres, une seule fois avant le rendu.
+ * @pre loadXMLs doit avoir été appelé au préalable.
+ * @return Le noyau spécialisé pour la méthode directe demandée.
+ * @throw std::invalid_argument Si la méthode directe ou indirecte demandée n'existe pas.
  */
-Color tonemap(const Color& initial)
+RenderKernel initializeMethod(void)
 {
-    tonemapped_color_t r = tonemapper({initial.r, initial.g, initial.b});
-    return Color(r[0], r[1], r[2], 1.0f);
+    if (RaytracingXml::indirectEnabled && RaytracingXml::indirectMethod != PHOTON_MAPPING_METHOD)
+    {
+        throw std::invalid_argument("Méthode indirecte inconnue : " + RaytracingXml::indirectMethod);
+    }
+    if (RaytracingXml::directEnabled)
+    {
+        DirectFactory fac;
+        return fac.craft(RaytracingXml::directMethod);
+    }
+    return selectKernel<NoDirect, false>();
 }
 
 /**
- * @brief Initialise les méthodes en fonctions des paramètres.
- * @param[out] direct   un pointeur de pointeur sur une méthode d'éclairage directe.
- * @param[out] indirect un pointeur de pointeur sur une méthode d'éclairage indirecte.
+ * @brief Écrit les sorties d'un rendu terminé.
+ * @param[in,out] image      L'image en luminance linéaire, tonemappée en place si besoin.
+ * @param[in]     tonemap    La passe de tonemapping.
+ * @param[in]     name       Le nom du .png, dont dérivent les autres sorties.
+ * @param[in]     png        Le .png déjà rempli bande par bande, nullptr s'il reste à écrire.
+ * @param[in]     checkpoint Le point de reprise à supprimer, nullptr si aucun.
  */
-void initializeMethod(Direct** direct/*, Indirect** indirect*/)
+void writeOutputs(Image& image, TonemapPass tonemap, const std::string& name, PngWriter* png, Checkpoint* checkpoint)
 {
-    if (RaytracingXml::directEnabled)
+    // La luminance linéaire est écrite avant le tonemapping, pour pouvoir le refaire hors ligne.
+    if (ImageXml::writeHdr)
     {
-        DirectFactory fac;
-        *direct = fac.craft(RaytracingXml::directMethod);
+        write_image_hdr(image, outputFile(name, ".hdr").c_str());
     }
-    /*if (RaytracingXml::indirectEnabled)
+    if (ImageXml::writePfm)
     {
-        IndirectFactory fac;
-        fac.recipes();
-        *indirect = fac.make(RaytracingXml::indirectMethod);
-    }*/
+        write_image_pfm(image, outputFile(name, ".pfm").c_str());
+    }
+    if (ImageXml::writePng)
+    {
+        std::cout << "Sauvegarde de " << name << std::endl;
+        if (png != nullptr)
+        {
+            png->close();
+        }
+        else
+        {
+            // Une image vide n'a pas de premier pixel à donner au tonemapping.
+            if (image.size() > 0)
+            {
+                tonemap(&image(0, 0), image.size(), ImageXml::gamma);
+            }
+            PngWriter::write(image, name);
+        }
+    }
+    if (checkpoint != nullptr)
+    {
+        checkpoint->finish();
+    }
 }
 
-int main(UNUSED(int argc), UNUSED(char** argv))
+/**
+ * @brief Fait un rendu complet avec les options courantes, jusqu'à l'écriture des images.
+ * @param[in]     program Le chemin de l'exécutable, pour relancer des workers.
+ * @param[in]     worker  Si ce processus est un worker du rendu réparti.
+ * @param[in,out] pending L'écriture encore en cours de l'image précédente d'une série, nullptr hors série.
+ * Avec ImageXml::overlap, l'écriture de cette image y est lancée en tache de fond une fois la précédente finie.
+ * @return Le code de sortie du programme.
+ * @pre loadXMLs doit avoir été appelé au préalable.
+ */
+int render(const std::string& program, bool worker, std::future<void>* pending = nullptr)
 {
-    ConfigLoaders::loadXMLs();
-    Image image(ImageXml::width, ImageXml::height);
+    TileBuffer frame(ImageXml::width, ImageXml::height);
     initializeScene();
-    Direct*   directMethod(nullptr);
-    //Indirect* indirectMethod(nullptr);
-    initializeMethod(&directMethod/*, &indirectMethod*/);
+    RenderKernel kernel  = initializeMethod();
+    TonemapPass  tonemap = TonemapFactory().craft(ImageXml::tonemap);
     
     Point o, d0;
     Vector dx0, dy0;
-    createNearPoint(image, o, d0, dx0, dy0);
+    createNearPoint(frame, o, d0, dx0, dy0);
+    if (worker)
+    {
+        return Distributed::serve(kernel, frame, o, d0, dx0, dy0);
+    }
     
-    timeBeginFunc("Debut du raytracing");
-    #pragma omp parallel for schedule(dynamic, 16) firstprivate(o, d0, dx0, dy0)
-    for(int y=0;y<image.height();++y)
+    // Sans sortie linéaire ni débruitage, chaque bande est tonemappée et compressée dès qu'elle est rendue.
+    const bool streamPng = ImageXml::writePng && !ImageXml::writeHdr && !ImageXml::writePfm && !ImageXml::denoise
+                        && !(ImageXml::aovs & (1u << AOV_BEAUTY));
+    const std::string name = ImageXml::outputName;
+    std::shared_ptr<PngWriter>  png;
+    std::shared_ptr<Checkpoint> checkpoint;
+    std::unique_ptr<Framebuffer> aovs;
+    RenderHooks hooks;
+    if (streamPng)
     {
-        for(int x=0;x<image.width();++x)
+        png.reset(new PngWriter(name, frame.width, frame.height));
+    }
+    if (RaytracingXml::checkpointEnabled)
+    {
+        checkpoint.reset(new Checkpoint(outputFile(name, ".ckpt"), RENDER_BAND_ROWS, RaytracingXml::checkpointInterval,
+                                        frame, hooks.skip));
+    }
+    const unsigned guides = ImageXml::denoise ? Denoiser::guides() : 0;
+    if (ImageXml::aovs != 0 || guides != 0)
+    {
+        aovs.reset(new Framebuffer(frame.width, frame.height, ImageXml::aovs, guides));
+        const unsigned shaded = (1u << AOV_DIRECT) | (1u << AOV_INDIRECT) | (1u << AOV_SAMPLES);
+        if (RaytracingXml::workers > 0 && (ImageXml::aovs & shaded))
         {
-            Color emited, direct, indirect;
-            Hit hitFromCamera;
-            Point e = d0 + x*dx0 + y*dy0;
-            Ray ray(o, e);
-            if (Scene::intersect(ray, hitFromCamera))
+            std::cerr << "[WARNING]: les workers ne renvoient que l'image, les AOV direct, indirect et samples resteront nulles."
+                      << std::endl;
+        }
+        hooks.aovs = aovs.get();
+    }
+    if (png || checkpoint)
+    {
+        // Le point de reprise garde les tuiles telles quelles, le .png reçoit une copie tonemappée de leurs lignes.
+        hooks.done = [&png, &checkpoint, tonemap](const TileBuffer& frame, int y0, int y1){
+            if (checkpoint)
             {
-                if (RaytracingXml::emitedEnabled)
-                {
-                    emited = Scene::mesh.triangle_material(hitFromCamera.object_id).emission;
-                }
-                if (RaytracingXml::directEnabled)
-                {
-                    direct = directMethod->compute(o, hitFromCamera, RaytracingXml::directN);
-                }
-                /*if (RaytracingXml::indirectEnabled)
-                {
-                    indirect = Black();
-                }*/
+                checkpoint->save(frame, y0, y1);
             }
-            image(x, y) = Color(tonemap(direct) + emited + indirect, 1.0f);
-        }
+            if (png)
+            {
+                std::vector<Color> rows(static_cast<std::size_t>(y1 - y0)*frame.width);
+                frame.resolve(rows.data(), y0, y1);
+                tonemap(rows.data(), rows.size(), ImageXml::gamma);
+                png->rows(rows.data(), y0, y1);
+            }
+        };
+    }
+
+    timeBeginFunc("Debut du raytracing");
+    if (RaytracingXml::workers > 0)
+    {
+        Distributed::render(kernel, frame, o, d0, dx0, dy0, hooks, RaytracingXml::workers, program);
+    }
+    else
+    {
+        kernel(frame, o, d0, dx0, dy0, hooks);
     }
     timeEndFunc();
     timePrint();
+    // Le png déjà écrit au fil des bandes, l'image n'est construite que pour les autres sorties.
+    Image image = (png && !aovs) ? Image() : frame.image();
+    if (aovs && RaytracingXml::workers > 0)
+    {
+        // Les workers ne renvoient que l'image : les AOV géométriques sont retrouvées ici.
+        aovs->trace(0, frame.height, o, d0, dx0, dy0);
+    }
+    if (ImageXml::denoise)
+    {
+        timeBeginFunc("Debruitage");
+        Denoiser::filter(image, *aovs);
+        timeEndFunc();
+        timePrint();
+    }
+    if (aovs)
+    {
+        aovs->write(image, name);
+    }
 
-    std::cout << "Sauvegarde de " << ImageXml::outputName << std::endl;
-    write_image(image, ImageXml::outputName.c_str());
+    if (pending == nullptr || !ImageXml::overlap)
+    {
+        writeOutputs(image, tonemap, name, png.get(), checkpoint.get());
+        return EXIT_SUCCESS;
+    }
+    // Une seule image en cours d'écriture à la fois, pour borner la mémoire.
+    if (pending->valid())
+    {
+        pending->get();
+    }
+    std::shared_ptr<Image> output = std::make_shared<Image>(std::move(image));
+    *pending = std::async(std::launch::async, [output, tonemap, name, png, checkpoint](void){
+        writeOutputs(*output, tonemap, name, png.get(), checkpoint.get());
+    });
     return EXIT_SUCCESS;
 }
+
+int main(int argc, char** argv)
+{
+    const bool worker = Distributed::worker(argc, argv);
+    ConfigLoaders::loadXMLs();
+    if (argc > 1 && std::strcmp(argv[1], RENDER_SERVER_FLAG) == 0)
+    {
+        const std::string program = argv[0];
+        return RenderServer::run(std::cin, [&program](void){return render(program, false);});
+    }
+    if (worker)
+    {
+        // Le coordinateur donne l'orbiter et l'image du tour en cours de sa série.
+        if (argc > 3)
+        {
+            SceneXml::orbiter = argv[2];
+            SceneXml::frame   = std::atoi(argv[3]);
+            ConfigLoaders::buildOutputName();
+        }
+        return render(argv[0], true);
+    }
+    
+    // Tous les orbiters, et toutes les images de leur tour, sont rendus à la suite, la scène restant chargée.
+    const std::vector<std::string> orbiters = SceneXml::orbiters;
+    const int frames = std::max(1, SceneXml::turntableFrames);
+    std::future<void> pending;
+    int status = EXIT_SUCCESS;
+    for(const std::string& orbiter : orbiters)
+    {
+        for(int frame=0;frame<frames;++frame)
+        {
+            SceneXml::orbiter = orbiter;
+            SceneXml::frame   = frame;
+            ConfigLoaders::buildOutputName();
+            if (render(argv[0], false, &pending) != EXIT_SUCCESS)
+            {
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    if (pending.valid())
+    {
+        pending.get();
+    }
+    return status;
+}
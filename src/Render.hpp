@@ -0,0 +1,178 @@
+/**
+ * @file Render.hpp
+ * @brief Le noyau de rendu, spécialisé une fois pour chaque méthode directe.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef RENDER_HPP_INCLUDED
+#define RENDER_HPP_INCLUDED
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "core/gkit_core.hpp"
+#include "core/ray_core.hpp"
+#include "structures/ShadowBatch.hpp"
+#include "structures/TileBuffer.hpp"
+#include "ConfigLoaders.hpp"
+#include "Framebuffer.hpp"
+#include "Indirect.hpp"
+
+#define RENDER_BAND_ROWS TILE_SIZE //!< Le nombre de lignes distribuées d'un coup à un thread.
+
+/**
+ * @brief Appelée par le thread qui vient de terminer les lignes [y0, y1) de @b frame.
+ * @details Permet de traiter la bande (tonemapping, écriture) pendant que le reste de l'image est rendu.
+ * La bande est encore en tuiles : chaque consommateur la lit telle quelle (cf TileBuffer::band)
+ * ou la convertit en lignes RGBA (cf TileBuffer::resolve).
+ */
+typedef std::function<void(const TileBuffer& frame, int y0, int y1)> BandDone;
+
+/**
+ * @struct RenderHooks
+ * @brief Ce que le noyau doit savoir en plus de la caméra : les bandes à sauter, quoi faire des bandes terminées
+ * et où ranger les AOV.
+ */
+struct RenderHooks
+{
+    std::vector<char> skip; //!< Pour chaque bande, 1 si elle est déjà dans le tampon (reprise), vide pour tout rendre.
+    BandDone          done; //!< Appelée à la fin de chaque bande, sautée ou non, peut etre vide.
+    Framebuffer*      aovs; //!< Les AOV à remplir, nullptr pour n'en remplir aucune.
+
+    RenderHooks(void) : skip(), done(), aovs(nullptr) {}
+};
+
+/**
+ * @brief Un noyau de rendu complet, choisi une seule fois au démarrage.
+ * @param[in,out] frame Le tampon dans lequel on va écrire le résultat.
+ * @param[in]     o     L'origine de tous les rayons.
+ * @param[in]     d0    Le coin du plan image.
+ * @param[in]     dx0   Le pas horizontal sur le plan image.
+ * @param[in]     dy0   Le pas vertical   sur le plan image.
+ * @param[in]     hooks Les bandes déjà rendues et le traitement des bandes terminées.
+ */
+typedef void (*RenderKernel)(TileBuffer& frame, const Point& o, const Point& d0, const Vector& dx0, const Vector& dy0,
+                             const RenderHooks& hooks);
+
+/**
+ * @brief Parcourt tous les pixels de @b frame avec la méthode directe @b Method.
+ * @details Les options de raytracing.xml sont des paramètres template, les branches inutiles disparaissent de la boucle.
+ * Le tampon reçoit la luminance linéaire, le tonemapping est une passe séparée (cf TonemapPass).
+ * Chaque bande est rendue tuile par tuile, dans l'ordre de Morton à l'intérieur d'une tuile.
+ * @tparam Method     Fournit Color compute(observer, impact, N, batch) en statique.
+ * @tparam Indirect   Fournit Color compute(observer, impact, N) en statique.
+ * @tparam Emited     Si on veut la luminosité émise.
+ * @tparam DirectOn   Si on veut la luminosité directe.
+ * @tparam IndirectOn Si on veut la luminosité indirecte.
+ * @tparam Aovs       Si des AOV sont activées, elles sont alors rangées dans hooks.aovs s'il n'est pas nul,
+ *                    celles des bandes sautées étant retrouvées par Framebuffer::trace.
+ * @see RenderKernel pour les paramètres.
+ */
+template<typename Method, typename Indirect, bool Emited, bool DirectOn, bool IndirectOn, bool Aovs>
+void renderKernel(TileBuffer& frame, const Point& o, const Point& d0, const Vector& dx0, const Vector& dy0,
+                  const RenderHooks& hooks)
+{
+    Framebuffer* aovs = Aovs ? hooks.aovs : nullptr;
+    const int bands = frame.bands();
+    #pragma omp parallel
+    {
+        ShadowBatch batch;
+        #pragma omp for schedule(dynamic)
+        for(int band=0;band<bands;++band)
+        {
+            const int y0 = band*RENDER_BAND_ROWS;
+            const int y1 = std::min(y0 + RENDER_BAND_ROWS, frame.height);
+            const bool skipped = (static_cast<std::size_t>(band) < hooks.skip.size()) && hooks.skip[band];
+            if (Aovs && aovs != nullptr && skipped)
+            {
+                aovs->trace(y0, y1, o, d0, dx0, dy0);
+            }
+            for(int tile=0;tile<frame.tiles() && !skipped;++tile)
+            for(int m=0;m<TILE_PIXELS;++m)
+            {
+                int x, y;
+                if (!frame.pixel(tile, m, y1 - y0, x, y))
+                {
+                    continue;
+                }
+                y += y0;
+                Color emited, direct, indirect;
+                Hit hitFromCamera;
+                Point e = d0 + x*dx0 + y*dy0;
+                Ray ray(o, e);
+                if ((Emited || DirectOn || IndirectOn) && Scene::intersect(ray, hitFromCamera))
+                {
+                    if (Emited)
+                    {
+                        emited = Scene::triangle_material(hitFromCamera.object_id).emission;
+                    }
+                    if (DirectOn)
+                    {
+                        direct = Method::compute(o, hitFromCamera, RaytracingXml::directN, batch);
+                    }
+                    if (IndirectOn)
+                    {
+                        indirect = Indirect::compute(o, hitFromCamera, RaytracingXml::indirectN);
+                    }
+                    if (Aovs && aovs != nullptr)
+                    {
+                        aovs->store(x, y, emited, direct, indirect, hitFromCamera, ray, batch.traced);
+                    }
+                }
+                frame.store(band, tile, m, direct + emited + indirect);
+            }
+            if (hooks.done)
+            {
+                hooks.done(frame, y0, y1);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Choisit l'instanciation de renderKernel selon la luminosité émise et les AOV.
+ * @tparam Method     La méthode directe, déjà spécialisée.
+ * @tparam Indirect   La méthode indirecte.
+ * @tparam DirectOn   Si @b Method calcule réellement la luminosité directe.
+ * @tparam IndirectOn Si @b Indirect calcule réellement la luminosité indirecte.
+ * @return Le noyau à appeler pour tout le rendu.
+ */
+template<typename Method, typename Indirect, bool DirectOn, bool IndirectOn>
+RenderKernel selectOutputKernel(void)
+{
+    // L'AOV beauty est prise dans le tampon, seules les autres et les guides du débruiteur passent par le noyau.
+    const bool aovs = (ImageXml::aovs & ~(1u << AOV_BEAUTY)) != 0 || ImageXml::denoise;
+    if (RaytracingXml::emitedEnabled)
+    {
+        if (aovs)
+        {
+            return &renderKernel<Method, Indirect, true, DirectOn, IndirectOn, true>;
+        }
+        return &renderKernel<Method, Indirect, true, DirectOn, IndirectOn, false>;
+    }
+    if (aovs)
+    {
+        return &renderKernel<Method, Indirect, false, DirectOn, IndirectOn, true>;
+    }
+    return &renderKernel<Method, Indirect, false, DirectOn, IndirectOn, false>;
+}
+
+/**
+ * @brief Choisit l'instanciation de renderKernel correspondant aux options chargées.
+ * @tparam Method   La méthode directe, déjà spécialisée.
+ * @tparam DirectOn Si @b Method calcule réellement la luminosité directe.
+ * @return Le noyau à appeler pour tout le rendu.
+ * @pre ConfigLoaders::loadXMLs doit avoir été appelé au préalable.
+ */
+template<typename Method, bool DirectOn>
+RenderKernel selectKernel(void)
+{
+    if (RaytracingXml::indirectEnabled)
+    {
+        return selectOutputKernel<Method, PhotonMapping, DirectOn, true>();
+    }
+    return selectOutputKernel<Method, NoIndirect, DirectOn, false>();
+}
+
+#endif
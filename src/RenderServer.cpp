@@ -0,0 +1,189 @@
+/**
+ * @file RenderServer.cpp
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+    #include <io.h>
+    #define dup  _dup
+    #define dup2 _dup2
+#else
+    #include <unistd.h>
+#endif
+
+#include "RenderServer.hpp"
+#include "ConfigLoaders.hpp"
+#include "SceneLibrary.hpp"
+
+namespace
+{
+    /**
+     * @struct JobSettings
+     * @brief Les options qu'une demande peut remplacer, pour revenir à celles des xml entre deux demandes.
+     */
+    struct JobSettings
+    {
+        std::string obj;
+        std::string orbiter;
+        int         width;
+        int         height;
+        float       fov;
+        std::string method;
+        int         N;
+        std::string output;
+        std::string tonemap;
+        float       gamma;
+
+        /**
+         * @brief Relève les options courantes.
+         */
+        JobSettings(void)
+            : obj(SceneXml::obj), orbiter(SceneXml::orbiter), width(ImageXml::width), height(ImageXml::height),
+              fov(ImageXml::fov), method(RaytracingXml::directMethod), N(RaytracingXml::directN),
+              output(ImageXml::outputBase), tonemap(ImageXml::tonemap), gamma(ImageXml::gamma)
+        {}
+        /**
+         * @brief Remet ces options en place.
+         */
+        void apply(void) const
+        {
+            SceneXml::obj               = this->obj;
+            SceneXml::orbiter           = this->orbiter;
+            ImageXml::width             = this->width;
+            ImageXml::height            = this->height;
+            ImageXml::fov               = this->fov;
+            RaytracingXml::directMethod = this->method;
+            RaytracingXml::directN      = this->N;
+            ImageXml::outputBase        = this->output;
+            ImageXml::tonemap           = this->tonemap;
+            ImageXml::gamma             = this->gamma;
+        }
+    };
+
+    /**
+     * @brief Convertit la valeur d'une option.
+     * @param[in]  key   Le nom de l'option, pour le message d'erreur.
+     * @param[in]  text  La valeur lue.
+     * @param[out] value La valeur convertie.
+     * @throw std::invalid_argument Si @b text n'est pas entièrement convertible.
+     */
+    template<typename T>
+    void parse(const std::string& key, const std::string& text, T& value)
+    {
+        std::istringstream stream(text);
+        if (!(stream >> value) || !stream.eof())
+        {
+            throw std::invalid_argument("valeur invalide pour " + key + " : " + text);
+        }
+    }
+
+    /**
+     * @brief Remplace les options données par une demande.
+     * @param[in] line La demande, une suite de clé=valeur séparées par des espaces.
+     * @throw std::invalid_argument Si une clé est inconnue ou une valeur invalide.
+     */
+    void applyRequest(const std::string& line)
+    {
+        typedef std::function<void(const std::string& key, const std::string& value)> Setter;
+        JobSettings settings;
+        const std::map<std::string, Setter> setters = {
+            {"obj",     [&settings](const std::string&, const std::string& v){settings.obj     = v;}},
+            {"orbiter", [&settings](const std::string&, const std::string& v){settings.orbiter = v;}},
+            {"method",  [&settings](const std::string&, const std::string& v){settings.method  = v;}},
+            {"output",  [&settings](const std::string&, const std::string& v){settings.output  = v;}},
+            {"tonemap", [&settings](const std::string&, const std::string& v){settings.tonemap = v;}},
+            {"width",   [&settings](const std::string& k, const std::string& v){parse(k, v, settings.width);}},
+            {"height",  [&settings](const std::string& k, const std::string& v){parse(k, v, settings.height);}},
+            {"fov",     [&settings](const std::string& k, const std::string& v){parse(k, v, settings.fov);}},
+            {"N",       [&settings](const std::string& k, const std::string& v){parse(k, v, settings.N);}},
+            {"gamma",   [&settings](const std::string& k, const std::string& v){parse(k, v, settings.gamma);}}
+        };
+        std::istringstream tokens(line);
+        std::string token;
+        while(tokens >> token)
+        {
+            const std::size_t equal = token.find('=');
+            if (equal == std::string::npos)
+            {
+                throw std::invalid_argument("clé=valeur attendu : " + token);
+            }
+            const auto setter = setters.find(token.substr(0, equal));
+            if (setter == setters.end())
+            {
+                throw std::invalid_argument("option inconnue : " + token.substr(0, equal));
+            }
+            setter->second(token.substr(0, equal), token.substr(equal + 1));
+        }
+        if (settings.width <= 0 || settings.height <= 0 || settings.N <= 0)
+        {
+            throw std::invalid_argument("width, height et N doivent etre positifs");
+        }
+        settings.apply();
+        ConfigLoaders::buildOutputName();
+    }
+}
+
+
+int RenderServer::run(std::istream& in, const RenderJob& render)
+{
+    // Les réponses gardent la sortie standard, tout le reste part sur la sortie d'erreur.
+    std::cout.flush();
+    std::fflush(stdout);
+    std::FILE* replies = fdopen(dup(1), "w");
+    dup2(2, 1);
+
+    const JobSettings defaults;
+    SceneLibrary::capacity(static_cast<std::size_t>(RaytracingXml::serverMemory) << 20);
+    // Les workers relisent les xml, ils ne verraient pas les options des demandes.
+    RaytracingXml::workers = 0;
+
+    std::string line;
+    while(std::getline(in, line) && line != "quit")
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        std::string error;
+        try
+        {
+            defaults.apply();
+            applyRequest(line);
+            if (render() != EXIT_SUCCESS)
+            {
+                error = "échec du rendu";
+            }
+        }
+        catch(const std::exception& e)
+        {
+            error = e.what();
+        }
+        catch(const std::string& e)
+        {
+            error = e;
+        }
+        std::cout.flush();
+        std::fflush(stdout);
+        if (error.empty())
+        {
+            const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+            std::fprintf(replies, "ok %s %.3f\n", ImageXml::outputName.c_str(), seconds.count());
+        }
+        else
+        {
+            std::fprintf(replies, "error %s\n", error.c_str());
+        }
+        std::fflush(replies);
+    }
+    std::fclose(replies);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file RenderServer.hpp
+ * @brief Un mode serveur qui enchaine les rendus sans quitter, les scènes restant en mémoire.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef RENDERSERVER_HPP_INCLUDED
+#define RENDERSERVER_HPP_INCLUDED
+
+#include <functional>
+#include <istream>
+
+/**
+ * @brief L'argument qui lance RayTracing en serveur de rendu.
+ */
+#define RENDER_SERVER_FLAG "--server"
+
+/**
+ * @class RenderServer
+ * @brief Lit des demandes de rendu, une par ligne, et les exécute avec les scènes de SceneLibrary.
+ * @details Une demande est une suite de @b clé=valeur, qui remplacent les valeurs des xml
+ * pour ce seul rendu : obj, orbiter, width, height, fov, method, N, output, tonemap et gamma.
+ * Une ligne vide ne fait rien, "quit" arrete le serveur.
+ *
+ * Chaque demande reçoit une ligne de réponse sur la sortie standard, "ok <image> <secondes>"
+ * ou "error <message>". Les messages du rendu passent sur la sortie d'erreur.
+ */
+class RenderServer final
+{
+    public:
+        /**
+         * @brief Le rendu d'une image avec les options courantes, comme un lancement classique.
+         * @return Le code de sortie du rendu, EXIT_SUCCESS s'il a réussi.
+         */
+        typedef std::function<int(void)> RenderJob;
+
+        /**
+         * @brief Traite les demandes de @b in jusqu'à sa fin ou jusqu'à "quit".
+         * @param[in] in     Le flux des demandes, std::cin en général.
+         * @param[in] render Le rendu à lancer pour chaque demande.
+         * @return EXIT_SUCCESS.
+         * @pre ConfigLoaders::loadXMLs doit avoir été appelé au préalable, il donne les valeurs par défaut.
+         */
+        static int run(std::istream& in, const RenderJob& render);
+
+        RenderServer(void) = delete;
+
+};
+
+
+#endif
@@ -1,44 +1,300 @@
 /**
  * @file Scene.cpp
  */
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 #include "Scene.hpp"
 
 Orbiter               Scene::camera;
 std::vector<Triangle> Scene::triangles;
 std::vector<Source>   Scene::sources;
+std::vector<ShadingMaterial> Scene::materials;
 Mesh                  Scene::mesh;
+#ifdef PACKET_WIDTH
+std::vector<TrianglePacket> Scene::packets;
+#endif
+std::vector<Triangle>      Scene::instanceTriangles;
+std::vector<InstancedMesh> Scene::meshes;
+std::vector<BinaryTree>    Scene::blas;
+std::vector<Instance>      Scene::instances;
+BinaryTree                 Scene::tlas;
+
+
+namespace
+{
+    /**
+     * @brief Remplit @b triangles directement depuis les tableaux du mesh, sans passer par Mesh::triangle.
+     * @details Les tests sur la présence des normales et des texcoords sont faits une seule fois,
+     * et la boucle est répartie entre les threads.
+     * @param[in]  mesh      Le mesh source, en GL_TRIANGLES.
+     * @param[out] triangles Le tableau à remplir, déjà dimensionné à mesh.triangle_count().
+     * @throw std::length_error Si le mesh a trop de matières pour Triangle::material.
+     */
+    void convertTriangles(const Mesh& mesh, std::vector<Triangle>& triangles)
+    {
+        const vec3*         positions = mesh.positions().data();
+        const vec3*         normals   = (mesh.normals().size() == mesh.positions().size()) ? mesh.normals().data() : nullptr;
+        const vec2*         texcoords = (mesh.texcoords().size() == mesh.positions().size()) ? mesh.texcoords().data() : nullptr;
+        const unsigned int* indices   = mesh.indices().empty() ? nullptr : mesh.indices().data();
+        const unsigned int* ids       = mesh.materials().data();
+        const int           idCount   = mesh.materials().size();
+        const int           count     = triangles.size();
+        if (mesh.mesh_materials().size() > std::numeric_limits<uint16_t>::max())
+        {
+            throw std::length_error("Trop de matières pour des indices sur 16 bits");
+        }
+
+        #pragma omp parallel for schedule(static)
+        for(int i=0;i<count;++i)
+        {
+            const unsigned int a = indices ? indices[3*i]   : 3*i;
+            const unsigned int b = indices ? indices[3*i+1] : 3*i+1;
+            const unsigned int c = indices ? indices[3*i+2] : 3*i+2;
+            Triangle& triangle = triangles[i];
+            triangle.material = (i < idCount) ? ids[i] : 0;
+            triangle.a = positions[a];
+            triangle.b = positions[b];
+            triangle.c = positions[c];
+            if (normals)
+            {
+                triangle.na = normals[a];
+                triangle.nb = normals[b];
+                triangle.nc = normals[c];
+            }
+            else
+            {
+                // normale géométrique, meme calcul que Mesh::triangle
+                const vec3 n = vec3(normalize(cross(Point(triangle.b) - Point(triangle.a), Point(triangle.c) - Point(triangle.a))));
+                triangle.na = n;
+                triangle.nb = n;
+                triangle.nc = n;
+            }
+            if (texcoords)
+            {
+                triangle.ta = texcoords[a];
+                triangle.tb = texcoords[b];
+                triangle.tc = texcoords[c];
+            }
+            else
+            {
+                triangle.ta = vec2(0, 0);
+                triangle.tb = vec2(1, 0);
+                triangle.tc = vec2(0, 1);
+            }
+        }
+    }
+    
+    /**
+     * @brief Ramène @b ray dans le repère d'une instance, sans normaliser sa direction.
+     * @param[in] instance L'instance.
+     * @param[in] ray      Le rayon, dans le repère de la scène.
+     * @param[in] tmax     L'abscisse maximale, la meme dans les deux repères.
+     * @return Le rayon dans le repère de l'objet.
+     */
+    inline Ray objectRay(const Instance& instance, const Ray& ray, float tmax)
+    {
+        Ray local(instance.toObject(ray.o), instance.toObject(ray.d));
+        local.tmax = tmax;
+        return local;
+    }
+    
+    /**
+     * @brief Cherche un impact plus proche que hit.t parmi les instances, en descendant du BVH
+     * des instances à celui de chaque mesh.
+     * @param[in]     ray Le rayon, dans le repère de la scène.
+     * @param[in,out] hit L'impact le plus proche, mis à jour si une instance est plus proche.
+     */
+    void intersectInstances(const Ray& ray, Hit& hit)
+    {
+        const std::size_t base = Scene::triangles.size();
+        int found = -1;
+        Scene::tlas.traverse(ray, hit.t, [&](triangle_ind_t first, triangle_ind_t count) -> bool {
+            for(triangle_ind_t i=first;i<first + count;++i)
+            {
+                const Instance&      instance = Scene::instances[i];
+                const InstancedMesh& mesh     = Scene::meshes[instance.mesh];
+                const Ray            local    = objectRay(instance, ray, hit.t);
+                Scene::blas[instance.mesh].traverse(local, hit.t, [&](triangle_ind_t leaf, triangle_ind_t size) -> bool {
+                    for(std::size_t j=mesh.first + leaf;j<mesh.first + leaf + size;++j)
+                    {
+                        float t, u, v;
+                        if (Scene::instanceTriangles[j].intersect(local, hit.t, t, u, v))
+                        {
+                            hit.t = t;
+                            hit.u = u;
+                            hit.v = v;
+                            hit.object_id = base + j;
+                            found = i;
+                        }
+                    }
+                    return false;
+                });
+            }
+            return false;
+        });
+        if (found != -1)
+        {
+            // Le t est le meme dans les deux repères, seule la normale doit etre ramenée dans la scène,
+            // et renormalisée : l'échelle de l'instance l'a étirée.
+            const Vector n = Scene::instanceTriangles[hit.object_id - base].normal(hit.u, hit.v);
+            hit.p = ray(hit.t);
+            hit.n = normalize(Scene::instances[found].normals(n));
+            hit.instance = found;
+        }
+    }
+    
+    /**
+     * @brief Vérifie si une instance coupe @b ray, sans chercher la plus proche.
+     * @param[in] ray Le rayon d'ombre, dans le repère de la scène, limité par son tmax.
+     * @return true si le rayon est occulté par une instance.
+     */
+    bool occludedInstances(const Ray& ray)
+    {
+        return Scene::tlas.traverse(ray, ray.tmax, [&ray](triangle_ind_t first, triangle_ind_t count) -> bool {
+            for(triangle_ind_t i=first;i<first + count;++i)
+            {
+                const Instance&      instance = Scene::instances[i];
+                const InstancedMesh& mesh     = Scene::meshes[instance.mesh];
+                const Ray            local    = objectRay(instance, ray, ray.tmax);
+                const bool occluded = Scene::blas[instance.mesh].traverse(local, local.tmax,
+                    [&local, &mesh](triangle_ind_t leaf, triangle_ind_t size) -> bool {
+                        for(std::size_t j=mesh.first + leaf;j<mesh.first + leaf + size;++j)
+                        {
+                            float t, u, v;
+                            if (Scene::instanceTriangles[j].intersect(local, local.tmax, t, u, v))
+                            {
+                                return true;
+                            }
+                        }
+                        return false;
+                    });
+                if (occluded)
+                {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+}
 
 
 unsigned int Scene::build_sources(void)
 {
-    for(int i=0;i<Scene::mesh.triangle_count();++i)
+    const std::vector<Material>& materials = Scene::mesh.mesh_materials();
+    for(std::size_t i=0;i<Scene::triangles.size() && !materials.empty();++i)
     {
-        Material material = Scene::mesh.triangle_material(i);
-        if((material.emission.r + material.emission.g + material.emission.b) > 0)
+        const Color& emission = materials[Scene::triangles[i].material].emission;
+        if((emission.r + emission.g + emission.b) > 0)
         {
-            Scene::sources.push_back(Source(Scene::mesh.triangle(i), material.emission));
+            Scene::sources.push_back(Source(Scene::triangles[i], emission));
         }
     }
     std::cout << "Nombre de sources : " << Scene::sources.size() << std::endl;
     return Scene::sources.size();
 }
 
-unsigned int Scene::build_triangles(void)
+unsigned int Scene::build_materials(float coef, float tolerance)
+{
+    const std::vector<Material>& materials = Scene::mesh.mesh_materials();
+    Scene::materials.clear();
+    Scene::materials.reserve(std::max<std::size_t>(materials.size(), 1));
+    for(const Material& material : materials)
+    {
+        Scene::materials.push_back(ShadingMaterial::build(material, coef, tolerance));
+    }
+    if (Scene::materials.empty())
+    {
+        // un .obj sans .mtl : tous les triangles pointent sur la matière par défaut
+        Scene::materials.push_back(ShadingMaterial::build(Material(), coef, tolerance));
+    }
+    return Scene::materials.size();
+}
+
+void Scene::convert_triangles(const Mesh& mesh, std::vector<Triangle>& triangles)
 {
-    Scene::triangles.reserve(Scene::mesh.triangle_count());
-    for(int i=0;i<Scene::mesh.triangle_count();++i)
+    triangles.resize(mesh.triangle_count());
+    convertTriangles(mesh, triangles);
+}
+
+bool Scene::bounds(Point& pmin, Point& pmax)
+{
+    BoundingBox bbox;
+    for(const Triangle& triangle : Scene::triangles)
+    {
+        bbox.insert(triangle.a);
+        bbox.insert(triangle.b);
+        bbox.insert(triangle.c);
+    }
+    for(const Instance& instance : Scene::instances)
     {
-        Scene::triangles.push_back(Triangle(Scene::mesh.triangle(i)));
+        bbox.insert(instance.bbox);
     }
+    if (Scene::triangles.empty() && Scene::instances.empty())
+    {
+        return false;
+    }
+    pmin = Point(bbox.pmin);
+    pmax = Point(bbox.pmax);
+    return true;
+}
+
+unsigned int Scene::build_triangles(void)
+{
+    Scene::convert_triangles(Scene::mesh, Scene::triangles);
+#ifdef PACKET_WIDTH
+    TrianglePacket::build(Scene::triangles, Scene::packets);
+#endif
     std::cout << "Nombre de triangles : " << Scene::triangles.size() << std::endl;
     return Scene::triangles.size();
 }
 
+#ifdef PACKET_WIDTH
 bool Scene::intersect(const Ray& ray, Hit& hit)
 {
     hit.t = ray.tmax;
+    hit.instance = -1;
+    for(std::size_t i=0;i<Scene::packets.size();++i)
+    {
+        float t, u, v;
+        int lane = Scene::packets[i].closest(ray, hit.t, t, u, v);
+        if (lane != -1)
+        {
+            const std::size_t id = i*PACKET_WIDTH + lane;
+            hit.t = t;
+            hit.u = u;
+            hit.v = v;
+            hit.p = ray(t);
+            hit.n = Scene::triangles[id].normal(u, v);
+            hit.object_id = id;
+        }
+    }
+    if (!Scene::instances.empty())
+    {
+        intersectInstances(ray, hit);
+    }
+    return (hit.object_id != -1);
+}
+
+bool Scene::occluded(const Ray& ray)
+{
+    for(std::size_t i=0;i<Scene::packets.size();++i)
+    {
+        if (Scene::packets[i].any(ray))
+        {
+            return true;
+        }
+    }
+    return !Scene::instances.empty() && occludedInstances(ray);
+}
+#else
+bool Scene::intersect(const Ray& ray, Hit& hit)
+{
+    hit.t = ray.tmax;
+    hit.instance = -1;
     for(std::size_t i=0;i<Scene::triangles.size();++i)
     {
         float t, u, v;
@@ -52,5 +308,23 @@ bool Scene::intersect(const Ray& ray, Hit& hit)
             hit.object_id = i; // permet de retrouver toutes les infos associees au triangle
         }
     }
+    if (!Scene::instances.empty())
+    {
+        intersectInstances(ray, hit);
+    }
     return (hit.object_id != -1);
 }
+
+bool Scene::occluded(const Ray& ray)
+{
+    for(std::size_t i=0;i<Scene::triangles.size();++i)
+    {
+        float t, u, v;
+        if(Scene::triangles[i].intersect(ray, ray.tmax, t, u, v))
+        {
+            return true;
+        }
+    }
+    return !Scene::instances.empty() && occludedInstances(ray);
+}
+#endif
@@ -1,7 +1,8 @@
 /**
  * @file Scene.hpp
  * @brief Embarque les éléments de la scène que l'on veut @i raytracer.@n
- * C'est un simple conteneur, aucun accès n'est fait en interne.
+ * C'est avant tout un conteneur, mais intersect et occluded parcourent en interne le BVH des instances (tlas)
+ * et celui de chaque mesh instancié (blas).
  * @author Laurent Bardoux p1108365
  * @author Mehdi   Ghesh   p1209574
  * @version 2.0
@@ -14,7 +15,11 @@
 #include "core/math_core.hpp"
 #include "core/gkit_core.hpp"
 #include "structures/Triangle.hpp"
+#include "structures/ShadingMaterial.hpp"
+#include "structures/TrianglePacket.hpp"
 #include "structures/Hit.hpp"
+#include "structures/Instance.hpp"
+#include "BinaryTree.hpp"
 
 
 /**
@@ -28,19 +33,71 @@ class Scene final
         static std::vector<Triangle> triangles; //!< Les triangles de la géometrie de la scène.
         static std::vector<Source>   sources;   //!< L'ensemble des sources de lumière de la scène.
         static Mesh                  mesh;      //!< Embarque la scène et les matériaux.
+        static std::vector<ShadingMaterial> materials; //!< Les matières prêtes pour le rendu, indexées par Triangle::material.
+#ifdef PACKET_WIDTH
+        static std::vector<TrianglePacket> packets; //!< Les triangles, rangés par paquets pour les intersections SIMD.
+#endif
+        static std::vector<Triangle>      instanceTriangles; //!< Les triangles des meshes instanciés, dans le repère de chaque objet.
+        static std::vector<InstancedMesh> meshes;    //!< Les meshes instanciés, chacun chargé une seule fois.
+        static std::vector<BinaryTree>    blas;      //!< Le BVH de chaque mesh instancié, dans le repère de l'objet.
+        static std::vector<Instance>      instances; //!< Les copies placées des meshes, dans l'ordre des feuilles de tlas.
+        static BinaryTree                 tlas;      //!< Le BVH des instances, dans le repère de la scène.
         
         /**
          * @brief Parcours le mesh interne pour trouver les sources de lumière.
          * @return Le nombre de sources trouvées.
-         * @pre Le mesh interne doit ^etre rempli.
+         * @pre build_triangles doit avoir été appelée, les sources sont copiées depuis Scene::triangles.
          */
         static unsigned int build_sources(void);
         /**
-         * @brief Génère les triangles depuis le mesh interne.
+         * @brief Génère les triangles (et leurs paquets SIMD) depuis le mesh interne.
          * @return Le nombre de triangles construit.
          * @pre Le mesh interne doit ^etre rempli.
          */
         static unsigned int build_triangles(void);
+        /**
+         * @brief Convertit les triangles d'un mesh, comme build_triangles mais sans toucher à la scène.
+         * @param[in]  mesh      Le mesh source, en GL_TRIANGLES.
+         * @param[out] triangles Les triangles, redimensionnés au nombre de triangles du mesh.
+         * @throw std::length_error Si le mesh a trop de matières pour Triangle::material.
+         */
+        static void convert_triangles(const Mesh& mesh, std::vector<Triangle>& triangles);
+        /**
+         * @brief Construit la table Scene::materials depuis les matières du mesh interne.
+         * @param[in] coef      Le coefficient de répartition pour l'albédo, intégré aux couleurs.
+         * @param[in] tolerance L'erreur relative acceptée sur les lobes spéculaires, cf ShadingMaterial::build.
+         * @return Le nombre de matières de la table.
+         * @pre Le mesh interne doit ^etre rempli (depuis le .obj ou le cache).
+         */
+        static unsigned int build_materials(float coef, float tolerance);
+        /**
+         * @brief Donne un triangle à partir de son identifiant.
+         * @param[in] id L'indice du triangle, tel que Hit::object_id : les identifiants au-delà de Scene::triangles
+         * désignent Scene::instanceTriangles, partagés par toutes les copies d'un meme mesh.
+         * @return Le triangle, dans le repère de son objet pour un mesh instancié.
+         */
+        static const Triangle& triangle(int id)
+        {
+            const std::size_t index = id;
+            return (index < Scene::triangles.size()) ? Scene::triangles[index]
+                                                     : Scene::instanceTriangles[index - Scene::triangles.size()];
+        }
+        /**
+         * @brief Donne la matière de rendu d'un triangle.
+         * @param[in] id L'indice du triangle, tel que Hit::object_id.
+         * @return L'entrée de Scene::materials correspondante.
+         */
+        static const ShadingMaterial& triangle_material(int id)
+        {
+            return Scene::materials[Scene::triangle(id).material];
+        }
+        /**
+         * @brief Donne la boite englobante de la scène, instances comprises.
+         * @param[out] pmin Le coin minimum.
+         * @param[out] pmax Le coin maximum.
+         * @return false si la scène est vide, les coins n'étant alors pas modifiés.
+         */
+        static bool bounds(Point& pmin, Point& pmax);
         /**
          * @brief Vérifie si il existe une intersection avec l'ensemble des triangles.
          * @param[in]  ray Le rayon partant de la caméra vers le far.
@@ -48,6 +105,12 @@ class Scene final
          * @return true si il existe une intersection, false sinon.
          */
         static bool intersect(const Ray& ray, Hit& hit);
+        /**
+         * @brief Vérifie si un triangle de la scène coupe @b ray, sans chercher le plus proche.
+         * @param[in] ray Le rayon d'ombre à tester, limité par son tmax.
+         * @return true si le rayon est occulté, false sinon.
+         */
+        static bool occluded(const Ray& ray);
         
         Scene(void) = delete;
     
@@ -0,0 +1,338 @@
+/**
+ * @file SceneCache.cpp
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+#include "SceneCache.hpp"
+#include "Scene.hpp"
+
+namespace
+{
+    const char     CACHE_MAGIC[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+    const uint32_t CACHE_VERSION  = 1;
+    #ifdef PACKET_WIDTH
+        const uint32_t CACHE_PACKET_WIDTH = PACKET_WIDTH;
+    #else
+        const uint32_t CACHE_PACKET_WIDTH = 0;
+    #endif
+
+    /**
+     * @struct CacheHeader
+     * @brief L'entete du cache, suivi des dépendances puis des tableaux dans l'ordre des compteurs.
+     */
+    struct CacheHeader
+    {
+        char     magic[8];          //!< CACHE_MAGIC.
+        uint32_t version;           //!< CACHE_VERSION.
+        uint32_t layout[4];         //!< Tailles des structures copiées telles quelles, pour rejeter un autre build.
+        uint32_t dependencies;      //!< Nombre de CacheDependency.
+        uint32_t materials;         //!< Nombre de Material.
+        uint32_t triangleMaterials; //!< Nombre d'indices de matière par triangle.
+        uint32_t triangles;         //!< Nombre de Triangle.
+        uint32_t sources;           //!< Nombre de Source.
+        uint32_t packets;           //!< Nombre de TrianglePacket.
+    };
+
+    /**
+     * @struct CacheDependency
+     * @brief Un fichier source du cache, comparé par taille et date de modification.
+     */
+    struct CacheDependency
+    {
+        int64_t size;       //!< La taille du fichier.
+        int64_t mtime;      //!< La date de dernière modification.
+        char    path[240];  //!< Le chemin, tel que lu dans scene.xml ou le .obj.
+    };
+
+    /**
+     * @brief Remplit @b layout avec les tailles des structures de ce build.
+     * @param[out] layout Les 4 valeurs à comparer.
+     */
+    void currentLayout(uint32_t layout[4]) noexcept
+    {
+        layout[0] = sizeof(Material);
+        layout[1] = sizeof(Triangle);
+        layout[2] = sizeof(Source);
+        layout[3] = CACHE_PACKET_WIDTH;
+    }
+
+    /**
+     * @brief Lit la taille et la date de modification de @b path.
+     * @param[in]  path Le chemin du fichier.
+     * @param[out] dep  La dépendance à remplir.
+     * @return false si le fichier n'existe pas ou si son chemin est trop long.
+     */
+    bool describe(const std::string& path, CacheDependency& dep) noexcept
+    {
+        struct stat info;
+        if (path.size() >= sizeof(dep.path) || stat(path.c_str(), &info) != 0)
+        {
+            return false;
+        }
+        std::memset(&dep, 0, sizeof(dep));
+        dep.size  = info.st_size;
+        dep.mtime = info.st_mtime;
+        std::memcpy(dep.path, path.c_str(), path.size());
+        return true;
+    }
+
+    /**
+     * @brief Liste les fichiers dont dépend la scène : le .obj et ses mtllib.
+     * @param[in]  obj  Le chemin du .obj.
+     * @param[out] deps Les dépendances trouvées.
+     * @return false si l'un des fichiers ne peut pas etre décrit.
+     */
+    bool dependencies(const std::string& obj, std::vector<CacheDependency>& deps)
+    {
+        CacheDependency dep;
+        if (!describe(obj, dep))
+        {
+            return false;
+        }
+        deps.push_back(dep);
+
+        // Meme résolution que read_mesh : relatif au dossier du .obj.
+        std::string::size_type slash = obj.find_last_of("/\\");
+        std::string directory = (slash == std::string::npos) ? "./" : obj.substr(0, slash+1);
+        std::ifstream file(obj);
+        std::string   line;
+        while(std::getline(file, line))
+        {
+            if (line.compare(0, 6, "mtllib") == 0)
+            {
+                std::string::size_type begin = line.find_first_not_of(" \t", 6);
+                std::string::size_type end   = line.find_last_not_of("\r\n");
+                if (begin != std::string::npos && end != std::string::npos && end >= begin)
+                {
+                    if (!describe(directory + line.substr(begin, end-begin+1), dep))
+                    {
+                        return false;
+                    }
+                    deps.push_back(dep);
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Ajoute les octets d'un tableau au flux.
+     * @param[in,out] file   Le flux binaire.
+     * @param[in]     values Le tableau à écrire.
+     */
+    template<typename T>
+    void writeArray(std::ofstream& file, const std::vector<T>& values)
+    {
+        if (!values.empty())
+        {
+            file.write(reinterpret_cast<const char*>(values.data()), values.size()*sizeof(T));
+        }
+    }
+
+    /**
+     * @brief Copie @b count éléments depuis le fichier projeté.
+     * @param[in,out] cursor La position de lecture, avancée après la copie.
+     * @param[in]     end    La fin du fichier projeté.
+     * @param[in]     count  Le nombre d'éléments.
+     * @param[out]    values Le tableau à remplir.
+     * @return false si le fichier est tronqué.
+     */
+    template<typename T>
+    bool readArray(const char*& cursor, const char* end, uint32_t count, std::vector<T>& values)
+    {
+        const std::size_t bytes = static_cast<std::size_t>(count)*sizeof(T);
+        if (static_cast<std::size_t>(end - cursor) < bytes)
+        {
+            return false;
+        }
+        values.resize(count);
+        if (bytes > 0)
+        {
+            std::memcpy(values.data(), cursor, bytes);
+        }
+        cursor += bytes;
+        return true;
+    }
+
+    /**
+     * @brief Vérifie l'entete et les dépendances, puis remplit Scene.
+     * @param[in] data Le contenu du cache.
+     * @param[in] size Sa taille en octets.
+     * @return true si le cache était valide.
+     */
+    bool parse(const char* data, std::size_t size)
+    {
+        CacheHeader header;
+        uint32_t    layout[4];
+        currentLayout(layout);
+        if (size < sizeof(header))
+        {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION
+            || std::memcmp(header.layout, layout, sizeof(layout)) != 0)
+        {
+            return false;
+        }
+
+        const char* cursor = data + sizeof(header);
+        const char* end    = data + size;
+        std::vector<CacheDependency> deps;
+        if (!readArray(cursor, end, header.dependencies, deps))
+        {
+            return false;
+        }
+        for(const CacheDependency& dep : deps)
+        {
+            CacheDependency now;
+            if (!describe(std::string(dep.path, strnlen(dep.path, sizeof(dep.path))), now) || now.size != dep.size || now.mtime != dep.mtime)
+            {
+                return false;
+            }
+        }
+
+        std::vector<Material>       materials;
+        std::vector<unsigned int>   triangleMaterials;
+        std::vector<Triangle>       triangles;
+        std::vector<Source>         sources;
+        #ifdef PACKET_WIDTH
+            std::vector<TrianglePacket> packets;
+        #endif
+        if (!readArray(cursor, end, header.materials, materials)
+            || !readArray(cursor, end, header.triangleMaterials, triangleMaterials)
+            || !readArray(cursor, end, header.triangles, triangles)
+            || !readArray(cursor, end, header.sources, sources)
+        #ifdef PACKET_WIDTH
+            || !readArray(cursor, end, header.packets, packets)
+        #endif
+            )
+        {
+            return false;
+        }
+
+        // Le mesh ne garde que les matières : les sommets sont déjà dans les triangles.
+        Scene::mesh = Mesh(GL_TRIANGLES);
+        Scene::mesh.mesh_materials(materials);
+        for(unsigned int id : triangleMaterials)
+        {
+            Scene::mesh.material(id);
+        }
+        Scene::triangles = std::move(triangles);
+        Scene::sources   = std::move(sources);
+        #ifdef PACKET_WIDTH
+            Scene::packets = std::move(packets);
+        #endif
+        return true;
+    }
+}
+
+
+std::string SceneCache::filename(const std::string& obj)
+{
+    return obj + ".cache";
+}
+
+bool SceneCache::load(const std::string& obj)
+{
+    const std::string fname = SceneCache::filename(obj);
+    bool loaded = false;
+#ifndef _WIN32
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            loaded = parse(static_cast<const char*>(map), info.st_size);
+            munmap(map, info.st_size);
+        }
+    }
+    close(fd);
+#else
+    std::ifstream file(fname, std::ios::binary);
+    std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    loaded = !content.empty() && parse(content.data(), content.size());
+#endif
+    if (loaded)
+    {
+        std::cout << "Chargement du cache " << fname << std::endl;
+        std::cout << "Nombre de triangles : " << Scene::triangles.size() << std::endl;
+        std::cout << "Nombre de sources : " << Scene::sources.size() << std::endl;
+    }
+    return loaded;
+}
+
+bool SceneCache::save(const std::string& obj)
+{
+    std::vector<CacheDependency> deps;
+    if (Scene::triangles.empty() || !dependencies(obj, deps))
+    {
+        return false;
+    }
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version           = CACHE_VERSION;
+    currentLayout(header.layout);
+    header.dependencies      = deps.size();
+    header.materials         = Scene::mesh.mesh_materials().size();
+    header.triangleMaterials = Scene::mesh.materials().size();
+    header.triangles         = Scene::triangles.size();
+    header.sources           = Scene::sources.size();
+    #ifdef PACKET_WIDTH
+        header.packets = Scene::packets.size();
+    #else
+        header.packets = 0;
+    #endif
+
+    // Écrit dans un fichier propre au processus, puis le renomme d'un coup : un processus tué ou
+    // deux écritures simultanées ne laissent jamais un cache tronqué à la place de l'ancien.
+    const std::string fname = SceneCache::filename(obj);
+#ifndef _WIN32
+    const std::string temporary = fname + ".tmp" + std::to_string(getpid());
+#else
+    const std::string temporary = fname + ".tmp";
+#endif
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeArray(file, deps);
+    writeArray(file, Scene::mesh.mesh_materials());
+    writeArray(file, Scene::mesh.materials());
+    writeArray(file, Scene::triangles);
+    writeArray(file, Scene::sources);
+    #ifdef PACKET_WIDTH
+        writeArray(file, Scene::packets);
+    #endif
+    file.close();
+    if (!file.good())
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(fname.c_str());
+#endif
+    if (std::rename(temporary.c_str(), fname.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file SceneCache.hpp
+ * @brief Un cache binaire de la scène préparée, rangé à coté du .obj.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef SCENECACHE_HPP_INCLUDED
+#define SCENECACHE_HPP_INCLUDED
+
+#include <string>
+
+
+/**
+ * @class SceneCache
+ * @brief Sauvegarde et recharge le contenu de Scene (hors caméra) en un seul fichier.
+ * @details Le fichier contient les matières, la matière de chaque triangle, les triangles,
+ * les sources et la structure accélératrice. Il est invalidé dès que la taille ou la date
+ * de modification du .obj ou de l'un de ses .mtl change.
+ */
+class SceneCache final
+{
+    public:
+        /**
+         * @brief Construit le nom du cache associé à un .obj.
+         * @param[in] obj Le chemin du .obj.
+         * @return Le chemin du cache.
+         */
+        static std::string filename(const std::string& obj);
+        /**
+         * @brief Remplit Scene depuis le cache de @b obj, projeté en mémoire d'un seul mmap.
+         * @param[in] obj Le chemin du .obj.
+         * @return true si le cache existe et est à jour, false sinon (Scene n'est alors pas modifiée).
+         */
+        static bool load(const std::string& obj);
+        /**
+         * @brief Écrit le cache de @b obj depuis le contenu actuel de Scene.
+         * @param[in] obj Le chemin du .obj dont Scene a été construite.
+         * @return true si l'écriture a réussi, false sinon.
+         * @pre Scene::build_triangles et Scene::build_sources doivent avoir été appelées.
+         */
+        static bool save(const std::string& obj);
+
+        SceneCache(void) = delete;
+
+};
+
+
+#endif
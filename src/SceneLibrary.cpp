@@ -0,0 +1,184 @@
+/**
+ * @file SceneLibrary.cpp
+ */
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <utility>
+#include <sys/stat.h>
+
+#include "SceneLibrary.hpp"
+#include "Instancing.hpp"
+#include "SceneCache.hpp"
+#include "Scene.hpp"
+
+namespace
+{
+    /**
+     * @struct ResidentScene
+     * @brief Une scène gardée en mémoire. Ses tableaux sont vides tant qu'elle est active dans Scene.
+     */
+    struct ResidentScene
+    {
+        std::string                 obj;       //!< Le chemin du .obj.
+        int64_t                     size;      //!< La taille du .obj au chargement.
+        int64_t                     mtime;     //!< La date du .obj au chargement.
+        std::size_t                 bytes;     //!< La mémoire occupée par les tableaux.
+        bool                        active;    //!< Si les tableaux sont actuellement dans Scene.
+        Mesh                        mesh;      //!< cf Scene::mesh.
+        std::vector<Triangle>       triangles; //!< cf Scene::triangles.
+        std::vector<Source>         sources;   //!< cf Scene::sources.
+#ifdef PACKET_WIDTH
+        std::vector<TrianglePacket> packets;   //!< cf Scene::packets.
+#endif
+    };
+
+    std::list<ResidentScene> scenes;                                        //!< Les scènes, la plus récente en tete.
+    std::size_t              limit = std::numeric_limits<std::size_t>::max(); //!< La mémoire maximale.
+
+    /**
+     * @brief Échange les tableaux de @b scene avec ceux de Scene.
+     * @param[in,out] scene La scène à activer, ou à ranger si elle est active.
+     */
+    void exchange(ResidentScene& scene)
+    {
+        std::swap(scene.mesh,      Scene::mesh);
+        std::swap(scene.triangles, Scene::triangles);
+        std::swap(scene.sources,   Scene::sources);
+#ifdef PACKET_WIDTH
+        std::swap(scene.packets,   Scene::packets);
+#endif
+        scene.active = !scene.active;
+    }
+
+    /**
+     * @brief Estime la mémoire occupée par le contenu actuel de Scene.
+     * @return Le nombre d'octets des tableaux.
+     */
+    std::size_t measure(void)
+    {
+        const Mesh& mesh = Scene::mesh;
+        std::size_t bytes = mesh.vertex_buffer_size() + mesh.normal_buffer_size() + mesh.texcoord_buffer_size()
+                          + mesh.color_buffer_size()  + mesh.index_buffer_size()
+                          + mesh.mesh_materials().size()*sizeof(Material) + mesh.materials().size()*sizeof(unsigned int)
+                          + Scene::triangles.size()*sizeof(Triangle) + Scene::sources.size()*sizeof(Source);
+#ifdef PACKET_WIDTH
+        bytes += Scene::packets.size()*sizeof(TrianglePacket);
+#endif
+        return bytes;
+    }
+
+    /**
+     * @brief Lit la taille et la date d'un fichier.
+     * @param[in]  path  Le fichier.
+     * @param[out] size  Sa taille, -1 s'il n'existe pas.
+     * @param[out] mtime Sa date de modification, -1 s'il n'existe pas.
+     */
+    void stamp(const std::string& path, int64_t& size, int64_t& mtime)
+    {
+        struct stat info;
+        size  = -1;
+        mtime = -1;
+        if (stat(path.c_str(), &info) == 0)
+        {
+            size  = info.st_size;
+            mtime = info.st_mtime;
+        }
+    }
+
+    /**
+     * @brief Libère les scènes inactives les plus anciennes tant que la limite est dépassée.
+     */
+    void evict(void)
+    {
+        std::size_t total = SceneLibrary::footprint();
+        auto it = scenes.end();
+        while(total > limit && it != scenes.begin())
+        {
+            --it;
+            if (!it->active)
+            {
+                std::cout << "Libération de la scène " << it->obj << std::endl;
+                total -= it->bytes;
+                it = scenes.erase(it);
+            }
+        }
+    }
+}
+
+
+bool SceneLibrary::acquire(const std::string& obj)
+{
+    int64_t size, mtime;
+    stamp(obj, size, mtime);
+    for(auto it = scenes.begin();it != scenes.end();++it)
+    {
+        if (it->active && it->obj != obj)
+        {
+            exchange(*it);
+        }
+    }
+    for(auto it = scenes.begin();it != scenes.end();++it)
+    {
+        if (it->obj != obj)
+        {
+            continue;
+        }
+        if (it->size == size && it->mtime == mtime)
+        {
+            if (!it->active)
+            {
+                exchange(*it);
+            }
+            scenes.splice(scenes.begin(), scenes, it);
+            return true;
+        }
+        // Le .obj a changé depuis son chargement.
+        if (it->active)
+        {
+            exchange(*it);
+        }
+        scenes.erase(it);
+        break;
+    }
+
+    Scene::mesh = Mesh();
+    Scene::triangles.clear();
+    Scene::sources.clear();
+#ifdef PACKET_WIDTH
+    Scene::packets.clear();
+#endif
+    if (!SceneCache::load(obj))
+    {
+        Scene::mesh = read_mesh(obj.c_str());
+        Scene::build_triangles();
+        Scene::build_sources();
+        SceneCache::save(obj);
+    }
+    ResidentScene scene;
+    scene.obj    = obj;
+    scene.size   = size;
+    scene.mtime  = mtime;
+    scene.bytes  = measure();
+    scene.active = true;
+    scenes.push_front(std::move(scene));
+    evict();
+    return false;
+}
+
+void SceneLibrary::capacity(std::size_t bytes)
+{
+    limit = bytes;
+    evict();
+}
+
+std::size_t SceneLibrary::footprint(void)
+{
+    std::size_t total = Instancing::footprint();
+    for(const ResidentScene& scene : scenes)
+    {
+        total += scene.bytes;
+    }
+    return total;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file SceneLibrary.hpp
+ * @brief Garde en mémoire les scènes déjà chargées, pour les rendus successifs d'un meme processus.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef SCENELIBRARY_HPP_INCLUDED
+#define SCENELIBRARY_HPP_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+
+/**
+ * @class SceneLibrary
+ * @brief Un cache LRU des contenus de Scene (hors caméra et matières de rendu), indexé par le chemin du .obj.
+ * @details La scène active vit dans Scene, les autres sont rangées ici. Changer de scène
+ * échange les tableaux sans les copier. Quand la mémoire occupée dépasse la limite,
+ * les scènes inactives les moins récemment utilisées sont libérées.
+ * Les meshes instanciés (cf Instancing) comptent dans cette mémoire sans jamais etre libérés :
+ * ils laissent d'autant moins de place aux scènes inactives.
+ */
+class SceneLibrary final
+{
+    public:
+        /**
+         * @brief Rend @b obj active dans Scene, en la chargeant (cache binaire ou .obj) si besoin.
+         * @param[in] obj Le chemin du .obj.
+         * @return true si la scène était déjà en mémoire, false si elle a été chargée.
+         * @note Une scène dont le .obj a changé (taille ou date) depuis son chargement est rechargée.
+         */
+        static bool acquire(const std::string& obj);
+        /**
+         * @brief Fixe la mémoire maximale des scènes gardées, la scène active et les meshes instanciés compris.
+         * @param[in] bytes La limite en octets, 0 pour ne garder que la scène active.
+         */
+        static void capacity(std::size_t bytes);
+        /**
+         * @brief Donne la mémoire occupée par toutes les scènes gardées et par les meshes instanciés.
+         * @return Le nombre d'octets, estimé depuis la taille des tableaux.
+         */
+        static std::size_t footprint(void);
+
+        SceneLibrary(void) = delete;
+
+};
+
+
+#endif
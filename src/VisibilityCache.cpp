@@ -0,0 +1,190 @@
+/**
+ * @file VisibilityCache.cpp
+ */
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "VisibilityCache.hpp"
+#include "ConfigLoaders.hpp"
+#include "Scene.hpp"
+
+namespace
+{
+    /**
+     * @struct CellKey
+     * @brief Une cellule de la grille et l'orientation de la normale.
+     */
+    struct CellKey
+    {
+        int32_t  x, y, z; //!< Les coordonnées de la cellule.
+        uint32_t normal;  //!< La normale, quantifiée sur 3 bits par composante, et la matière au-dessus.
+
+        bool operator==(const CellKey& other) const noexcept
+        {
+            return x == other.x && y == other.y && z == other.z && normal == other.normal;
+        }
+    };
+
+    /**
+     * @struct CellHash
+     * @brief Mélange les composantes de CellKey, les bits de poids faible choisissant aussi la sous-table.
+     */
+    struct CellHash
+    {
+        std::size_t operator()(const CellKey& key) const noexcept
+        {
+            uint64_t h = static_cast<uint32_t>(key.x)*0x9E3779B97F4A7C15ULL;
+            h ^= static_cast<uint32_t>(key.y)*0xC2B2AE3D27D4EB4FULL + (h << 6) + (h >> 2);
+            h ^= static_cast<uint32_t>(key.z)*0x165667B19E3779F9ULL + (h << 6) + (h >> 2);
+            h ^= key.normal*0x27D4EB2F165667C5ULL + (h << 6) + (h >> 2);
+            return static_cast<std::size_t>(h ^ (h >> 29));
+        }
+    };
+
+    /**
+     * @struct Shard
+     * @brief Une sous-table et son verrou.
+     */
+    struct Shard
+    {
+        std::mutex lock;
+        std::unordered_map<CellKey, std::vector<uint64_t>, CellHash> cells;
+    };
+
+    /**
+     * @struct CacheSettings
+     * @brief Ce dont dépend la visibilité enregistrée.
+     */
+    struct CacheSettings
+    {
+        std::string obj;
+        std::string method;
+        int         N;
+        float       tweak;
+        float       cell;
+
+        bool operator==(const CacheSettings& other) const noexcept
+        {
+            return obj == other.obj && method == other.method && N == other.N
+                && tweak == other.tweak && cell == other.cell;
+        }
+    };
+
+    std::array<Shard, VISIBILITY_SHARDS> shards;
+    CacheSettings settings = {std::string(), std::string(), 0, 0.0f, 0.0f};
+    float         inverseCell   = 0.0f; //!< 1/taille d'une cellule, en unités du monde.
+    float         nearDistance2 = 0.0f; //!< Le carré de la distance en dessous de laquelle un échantillon est toujours tracé.
+    bool          ready         = false; //!< Si prepare() a été appelée avec le cache activé.
+
+    /**
+     * @brief Construit la clé de la cellule contenant le point d'impact.
+     * @details La matière sépare deux surfaces parallèles et proches, comme une source et le plafond qui la porte.
+     * @param[in] impact Le point d'impact.
+     * @return La clé.
+     */
+    CellKey cellOf(const Hit& impact) noexcept
+    {
+        const Point& p = impact.p;
+        const Vector u = normalize(impact.n);
+        const auto quantize = [](float c) -> uint32_t {
+            return std::min(7, std::max(0, static_cast<int>((c + 1.0f)*4.0f)));
+        };
+        CellKey key;
+        key.x      = static_cast<int32_t>(std::floor(p.x*inverseCell));
+        key.y      = static_cast<int32_t>(std::floor(p.y*inverseCell));
+        key.z      = static_cast<int32_t>(std::floor(p.z*inverseCell));
+        key.normal = quantize(u.x) | (quantize(u.y) << 3) | (quantize(u.z) << 6)
+                   | (static_cast<uint32_t>(Scene::triangle(impact.object_id).material) << 9);
+        return key;
+    }
+
+    /**
+     * @brief Donne la diagonale de la boite englobante de la scène.
+     * @return La longueur de la diagonale, 1 pour une scène vide.
+     */
+    float sceneDiagonal(void)
+    {
+        Point pmin, pmax;
+        if (!Scene::bounds(pmin, pmax))
+        {
+            return 1.0f;
+        }
+        return std::max(distance(pmin, pmax), 1e-6f);
+    }
+}
+
+
+void VisibilityCache::prepare(void)
+{
+    ready = RaytracingXml::visibilityCache && RaytracingXml::directEnabled;
+    if (!ready)
+    {
+        return;
+    }
+    const CacheSettings current = {SceneXml::obj, RaytracingXml::directMethod, RaytracingXml::directN,
+                                   RaytracingXml::normalTweak, RaytracingXml::visibilityCell};
+    if (!(current == settings))
+    {
+        VisibilityCache::clear();
+        settings    = current;
+        const float cell = RaytracingXml::visibilityCell*sceneDiagonal();
+        inverseCell   = 1.0f/cell;
+        nearDistance2 = (VISIBILITY_NEAR_CELLS*cell)*(VISIBILITY_NEAR_CELLS*cell);
+    }
+}
+
+void VisibilityCache::clear(void)
+{
+    for(Shard& shard : shards)
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.cells.clear();
+    }
+    settings.obj.clear();
+}
+
+unsigned int VisibilityCache::trace(const Hit& impact, ShadowBatch& batch)
+{
+    const CellKey key = cellOf(impact);
+    Shard& shard = shards[CellHash()(key) % VISIBILITY_SHARDS];
+    std::vector<uint64_t> mask;
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        const auto it = shard.cells.find(key);
+        if (it != shard.cells.end() && it->second.size() == (batch.size() + 63)/64)
+        {
+            mask = it->second;
+        }
+    }
+    if (!mask.empty())
+    {
+        // Les échantillons proches restent tracés : leur visibilité change trop d'un point à l'autre de la cellule.
+        return batch.select([&batch, &mask](unsigned int i){
+            if (distance2(batch.rays[i].o, batch.points[i]) < nearDistance2)
+            {
+                return !batch.occluded(i);
+            }
+            return ((mask[i >> 6] >> (i & 63)) & 1) != 0;
+        });
+    }
+    // Les rayons sont lancés hors du verrou, deux threads peuvent donc remplir la meme cellule.
+    const unsigned int visible = batch.trace(mask);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if (shard.cells.size() >= VISIBILITY_SHARD_ENTRIES)
+    {
+        shard.cells.clear();
+    }
+    shard.cells[key] = std::move(mask);
+    return visible;
+}
+
+bool VisibilityCache::active(void) noexcept
+{
+    return ready;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file VisibilityCache.hpp
+ * @brief Réutilise la visibilité des sources d'une image à l'autre d'une animation de caméra.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef VISIBILITYCACHE_HPP_INCLUDED
+#define VISIBILITYCACHE_HPP_INCLUDED
+
+#include "core/gkit_core.hpp"
+#include "Scene.hpp"
+#include "structures/ShadowBatch.hpp"
+
+/**
+ * @brief Le nombre de sous-tables, chacune protégée par son propre verrou.
+ */
+#define VISIBILITY_SHARDS 64
+/**
+ * @brief Le nombre maximum d'entrées d'une sous-table, qui est vidée une fois pleine.
+ */
+#define VISIBILITY_SHARD_ENTRIES (1 << 16)
+/**
+ * @brief La distance, en cellules, en dessous de laquelle un échantillon de source est toujours tracé.
+ */
+#define VISIBILITY_NEAR_CELLS 16.0f
+
+/**
+ * @class VisibilityCache
+ * @brief Une grille de hachage en espace monde qui garde, par cellule, orientation de la normale et matière,
+ * quels échantillons des sources sont visibles.
+ * @details La visibilité ne dépend pas du point de vue : tant que la géométrie, les sources et
+ * l'échantillonnage ne changent pas, une image suivante la relit au lieu de relancer les rayons d'ombre.
+ * Seule la BRDF, qui dépend de l'observateur, est réévaluée. Tous les points d'une meme cellule
+ * partagent la visibilité du premier d'entre eux, la taille des cellules règle donc la précision des ombres.
+ * Seuls les échantillons éloignés sont réutilisés : près d'une source, G varie trop d'un point à l'autre.
+ */
+class VisibilityCache final
+{
+    public:
+        /**
+         * @brief Active le cache pour le prochain rendu, en le vidant si ce qui détermine la visibilité a changé.
+         * @details Compare le .obj, la méthode directe, N, le décalage des normales et la taille des cellules.
+         * @pre La scène doit etre chargée et la configuration lue.
+         */
+        static void prepare(void);
+        /**
+         * @brief Vide le cache, par exemple quand la scène vient d'etre (re)chargée.
+         */
+        static void clear(void);
+        /**
+         * @brief Remplace ShadowBatch::trace() en réutilisant la visibilité connue autour de @b impact.
+         * @param[in]     impact Le point d'impact, avant décalage.
+         * @param[in,out] batch  Le tampon rempli par generate().
+         * @return Le nombre d'échantillons non occultés.
+         * @note Peut etre appelée depuis plusieurs threads à la fois.
+         */
+        static unsigned int trace(const Hit& impact, ShadowBatch& batch);
+        /**
+         * @brief Pour savoir si Direct doit passer par le cache.
+         * @return true si RaytracingXml::visibilityCache est actif et prepare() a été appelée.
+         */
+        static bool active(void) noexcept;
+
+        VisibilityCache(void) = delete;
+
+};
+
+
+#endif
@@ -64,6 +64,11 @@ XmlLoader& XmlLoader::element(const std::string &elementName)
 	return *this;
 }
 
+bool XmlLoader::hasElement(const std::string &elementName) const
+{
+	return this->currentNode->FirstChildElement(elementName.c_str()) != nullptr;
+}
+
 XmlLoader& XmlLoader::prev(uint32_t of)
 {
 	this->_prev(of);
@@ -67,6 +67,14 @@ class XmlLoader final : public _XmlBase
 		 */
 		XmlLoader& element(const std::string &elementName);
 		
+		/**
+		 * @brief Check if the current node has a child element named \a elementName,
+		 * without selecting it nor printing any warning.
+		 * @param[in] elementName The name of the element you look for.
+		 * @return true if such an element exists, false otherwise.
+		 */
+		bool hasElement(const std::string &elementName) const;
+		
 		/**
 		 * @brief This function allows you to get the value into an attribute named \a att
 		 *  from a previously selected element (with element("field") method).
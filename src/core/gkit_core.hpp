@@ -8,6 +8,7 @@
 #include "wavefront.h"
 #include "image.h"
 #include "image_io.h"
+#include "image_hdr.h"
 #include "orbiter.h"
 
 #endif
@@ -2,9 +2,90 @@
 #define MATH_CORE_HPP_INCLUDED
 
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <cmath>
 #include <cfloat>
+#include <cstdint>
+#include <cstring>
 
 #define EPSILON 0.00001f
 
+/**
+ * @brief Approxime log2(x) sans branchement.
+ * @details La mantisse est ramenée dans [sqrt(1/2), sqrt(2)), puis log2(m) = 2/ln2 * atanh(s)
+ * avec s = (m-1)/(m+1), développé jusqu'à s^7. L'erreur absolue reste sous 1e-6.
+ * @param[in] x La valeur, normalisée et strictement positive.
+ * @return log2(x)
+ */
+inline float fastLog2(float x) noexcept
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    const int32_t  shifted = static_cast<int32_t>(bits) - 0x3f3504f3;
+    const int32_t  e       = shifted >> 23;
+    const uint32_t mbits   = static_cast<uint32_t>(shifted & 0x007fffff) + 0x3f3504f3;
+    float m;
+    std::memcpy(&m, &mbits, sizeof(m));
+    const float s  = (m - 1.0f)/(m + 1.0f);
+    const float s2 = s*s;
+    return static_cast<float>(e) + s*(2.88539008f + s2*(0.961796694f + s2*(0.577078016f + s2*0.412198583f)));
+}
+
+/**
+ * @brief Approxime 2^y sans branchement.
+ * @details La partie entière est placée dans l'exposant, la partie fractionnaire (dans [-0.5, 0.5])
+ * passe par un polynome de degré 6. Le résultat est borné à [2^-126, 2^127].
+ * @param[in] y L'exposant.
+ * @return 2^y
+ */
+inline float fastExp2(float y) noexcept
+{
+    y = std::min(std::max(y, -126.0f), 127.0f);
+    const float i = (y + 12582912.0f) - 12582912.0f; // arrondi à l'entier le plus proche
+    const float f = y - i;
+    const float p = 1.0f + f*(0.693147181f + f*(0.240226507f + f*(0.0555041087f + f*(0.00961812911f + f*(0.00133335581f + f*0.000154035304f)))));
+    const uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(i) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p*scale;
+}
+
+/**
+ * @brief Approxime x^y par 2^(y*log2(x)), pour les lobes spéculaires.
+ * @param[in] x La base, dans [0, 1] pour un cosinus.
+ * @param[in] y L'exposant, positif.
+ * @return x^y, 0 si x est nul ou négatif, 1 si y est nul (comme std::pow(0, 0)).
+ * @see fastPowError pour l'erreur réellement obtenue avec un exposant donné.
+ */
+inline float fastPow(float x, float y) noexcept
+{
+    if (y == 0.0f)
+    {
+        return 1.0f;
+    }
+    return (x > FLT_MIN) ? fastExp2(y*fastLog2(x)) : 0.0f;
+}
+
+/**
+ * @brief Mesure l'erreur relative maximale de fastPow(x, y) face à std::pow, pour x dans ]0, 1].
+ * @details Les valeurs de référence sous FLT_MIN sont ignorées, elles ne contribuent pas à l'image.
+ * @param[in] y       L'exposant à vérifier.
+ * @param[in] samples Le nombre de valeurs de x testées.
+ * @return L'erreur relative maximale observée.
+ */
+inline float fastPowError(float y, int samples = 4096) noexcept
+{
+    double error = 0.0;
+    for(int i=1;i<=samples;++i)
+    {
+        const float  x         = static_cast<float>(i)/static_cast<float>(samples);
+        const double reference = std::pow(static_cast<double>(x), static_cast<double>(y));
+        if (reference > FLT_MIN)
+        {
+            error = std::max(error, std::fabs(fastPow(x, y) - reference)/reference);
+        }
+    }
+    return static_cast<float>(error);
+}
+
 #endif
@@ -7,41 +7,63 @@
 ///@{
 
 //! \file
-//! manipulation de couleurs
+//! manipulation de couleurs, toutes les operations sont inline.
+
+//! GK_SIMD (optionnel) : les operations sur les couleurs utilisent SSE, cf vec.h.
+#if defined(GK_SIMD) && (defined(__SSE__) || defined(_M_X64))
+    #define GK_SSE_COLOR
+    #include <xmmintrin.h>
+    #define GK_COLOR_ALIGN alignas(16)
+#else
+    #define GK_COLOR_ALIGN
+#endif
 
 //! representation d'une couleur (rgba) transparente ou opaque.
-struct Color
+struct GK_COLOR_ALIGN Color
 {
     //! constructeur par defaut.
-    Color( const float _r= 0.f, const float _g= 0.f, const float _b= 0.f, const float _a= 1.f ) : r(_r), g(_g), b(_b), a(_a) {}
+    constexpr Color( const float _r= 0.f, const float _g= 0.f, const float _b= 0.f, const float _a= 1.f ) : r(_r), g(_g), b(_b), a(_a) {}
     //! cree une couleur avec les memes composantes que color, mais remplace sa composante alpha (color.r, color.g, color.b, alpha).
-    Color( const Color& color, const float alpha ) : r(color.r), g(color.g), b(color.b), a(alpha) {}  // remplace alpha.
-    
-    float power( ) const;
-    
+    constexpr Color( const Color& color, const float alpha ) : r(color.r), g(color.g), b(color.b), a(alpha) {}  // remplace alpha.
+
+    float power( ) const { return r+g+b; }
+
     float r, g, b, a;
 };
 
 //! utilitaire. renvoie une couleur noire.
-Color Black( );
+constexpr Color Black( ) { return Color(0, 0, 0); }
 //! utilitaire. renvoie une couleur blanche.
-Color White( );
+constexpr Color White( ) { return Color(1, 1, 1); }
 //! utilitaire. renvoie une couleur rouge.
-Color Red( );
+constexpr Color Red( ) { return Color(1, 0, 0); }
 //! utilitaire. renvoie une couleur verte.
-Color Green( );
+constexpr Color Green( ) { return Color(0, 1, 0); }
 //! utilitaire. renvoie une couleur bleue.
-Color Blue( );
-
-Color operator+ ( const Color& a, const Color& b );
-Color operator- ( const Color& a, const Color& b );
-Color operator- ( const Color& c );
-Color operator* ( const Color& a, const Color& b );
-Color operator* ( const Color& c, const float k );
-Color operator* ( const float k, const Color& c );
-Color operator/ ( const Color& a, const Color& b );
-Color operator/ ( const float k, const Color& c );
-Color operator/ ( const Color& c, const float k );
+constexpr Color Blue( ) { return Color(0, 0, 1); }
+
+#ifdef GK_SSE_COLOR
+inline __m128 simd_load( const Color& c ) { return _mm_load_ps(&c.r); }
+inline Color simd_color( const __m128 m ) { Color c; _mm_store_ps(&c.r, m); return c; }
+
+inline Color operator+ ( const Color& a, const Color& b ) { return simd_color(_mm_add_ps(simd_load(a), simd_load(b))); }
+inline Color operator- ( const Color& c ) { return simd_color(_mm_xor_ps(simd_load(c), _mm_set1_ps(-0.f))); }
+inline Color operator* ( const Color& a, const Color& b ) { return simd_color(_mm_mul_ps(simd_load(a), simd_load(b))); }
+inline Color operator* ( const float k, const Color& c ) { return simd_color(_mm_mul_ps(simd_load(c), _mm_set1_ps(k))); }
+inline Color operator/ ( const Color& a, const Color& b ) { return simd_color(_mm_div_ps(simd_load(a), simd_load(b))); }
+inline Color operator/ ( const float k, const Color& c ) { return simd_color(_mm_div_ps(_mm_set1_ps(k), simd_load(c))); }
+#else
+inline Color operator+ ( const Color& a, const Color& b ) { return Color(a.r + b.r, a.g + b.g, a.b + b.b, a.a + b.a); }
+inline Color operator- ( const Color& c ) { return Color(-c.r, -c.g, -c.b, -c.a); }
+inline Color operator* ( const Color& a, const Color& b ) { return Color(a.r * b.r, a.g * b.g, a.b * b.b, a.a * b.a); }
+inline Color operator* ( const float k, const Color& c ) { return Color(c.r * k, c.g * k, c.b * k, c.a * k); }
+inline Color operator/ ( const Color& a, const Color& b ) { return Color(a.r / b.r, a.g / b.g, a.b / b.b, a.a / b.a); }
+inline Color operator/ ( const float k, const Color& c ) { return Color(k / c.r, k / c.g, k / c.b, k / c.a); }
+#endif
+
+inline Color operator- ( const Color& a, const Color& b ) { return a + (-b); }
+inline Color operator* ( const Color& c, const float k ) { return k * c; }
+inline Color operator/ ( const Color& c, const float k ) { float kk= 1 / k; return kk * c; }
 
 ///@}
 #endif
@@ -1,5 +1,8 @@
 
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include "rgbe.h"
 #include "image_hdr.h"
@@ -100,3 +103,59 @@ int write_image_hdr( const Image& image, const char *filename )
     printf("writing hdr image '%s'...\n", filename);
     return 0;
 }
+
+
+bool is_pfm_image( const char *filename )
+{
+    return (std::string(filename).rfind(".pfm") != std::string::npos);
+}
+
+// le signe de l'echelle d'un .pfm donne l'ordre des octets : negatif pour little endian.
+static bool little_endian( )
+{
+    uint16_t one= 1;
+    unsigned char byte;
+    memcpy(&byte, &one, 1);
+    return (byte == 1);
+}
+
+int write_image_pfm( const Image& image, const char *filename )
+{
+    if(image == Image::error())
+        return -1;
+
+    FILE *out= fopen(filename, "wb");
+    if(out == NULL)
+    {
+        printf("[error] writing pfm image '%s'...\n", filename);
+        return -1;
+    }
+
+    int width= image.width();
+    int height= image.height();
+    fprintf(out, "PF\n%d %d\n%s\n", width, height, little_endian() ? "-1.0" : "1.0");
+
+    std::vector<float> data(width*height*3, 0.f);
+    int i= 0;
+    for(int y= 0; y < height; y++)
+    for(int x= 0; x < width; x++)
+    {
+        Color color= image(x, y);
+        data[i]= color.r;
+        data[i+1]= color.g;
+        data[i+2]= color.b;
+        i= i + 3;
+    }
+
+    size_t written= fwrite(&data.front(), sizeof(float), data.size(), out);
+    fclose(out);
+
+    if(written != data.size())
+    {
+        printf("[error] writing pfm image '%s'...\n", filename);
+        return -1;
+    }
+
+    printf("writing pfm image '%s'...\n", filename);
+    return 0;
+}
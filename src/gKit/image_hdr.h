@@ -21,6 +21,12 @@ int write_image_hdr( const Image& image, const char *filename );
 //! renvoie vrai si le nom de fichier se termine par .hdr.
 bool is_hdr_image( const char *filename );
 
+//! enregistre une image dans un fichier .pfm, sans compression ni perte de precision.
+int write_image_pfm( const Image& image, const char *filename );
+
+//! renvoie vrai si le nom de fichier se termine par .pfm.
+bool is_pfm_image( const char *filename );
+
 //@}
 
 #endif
@@ -7,7 +7,16 @@
 ///@{
 
 //! \file
-//! operations sur points et vecteurs
+//! operations sur points et vecteurs, toutes inline.
+
+//! GK_SIMD (optionnel) : Point et Vector sont stockes sur 4 floats alignes (w == 0) et les operations composante par composante utilisent SSE.
+#if defined(GK_SIMD) && (defined(__SSE__) || defined(_M_X64))
+    #define GK_SSE
+    #include <xmmintrin.h>
+    #define GK_ALIGN alignas(16)
+#else
+    #define GK_ALIGN
+#endif
 
 //! declarations anticipees.
 struct vec2;
@@ -16,10 +25,14 @@ struct vec4;
 struct Vector;
 
 //! representation d'un point 3d.
-struct Point
+struct GK_ALIGN Point
 {
     //! constructeur par defaut.
-    Point( const float _x= 0, const float _y= 0, const float _z= 0 ) : x(_x), y(_y), z(_z) {}
+#ifdef GK_SSE
+    constexpr Point( const float _x= 0, const float _y= 0, const float _z= 0 ) : x(_x), y(_y), z(_z), w(0) {}
+#else
+    constexpr Point( const float _x= 0, const float _y= 0, const float _z= 0 ) : x(_x), y(_y), z(_z) {}
+#endif
 
     //! cree un point a partir des coordonnees du vecteur generique (v.x, v.y, v.z).
     explicit Point( const vec3& v );   // l'implementation se trouve en fin de fichier, la structure vec3 n'est pas encore connue.
@@ -30,24 +43,34 @@ struct Point
     float operator() ( const unsigned int i ) const; // l'implementation se trouve en fin de fichier
     
     float x, y, z;
+#ifdef GK_SSE
+    float w;    //!< bourrage, toujours 0.
+#endif
 };
 
 //! renvoie la distance etre 2 points.
-float distance( const Point& a, const Point& b );
+inline float distance( const Point& a, const Point& b );
 //! renvoie le carre de la distance etre 2 points.
-float distance2( const Point& a, const Point& b );
+inline float distance2( const Point& a, const Point& b );
 
 //! renvoie le milieu du segment ab.
-Point center( const Point& a, const Point& b );
+inline Point center( const Point& a, const Point& b );
 
 
 //! representation d'un vecteur 3d.
-struct Vector
+struct GK_ALIGN Vector
 {
+#ifdef GK_SSE
+    //! constructeur par defaut.
+    constexpr Vector( const float _x= 0, const float _y= 0, const float _z= 0) : x(_x), y(_y), z(_z), w(0) {}
+    //! cree le vecteur ab.
+    constexpr Vector( const Point& a, const Point& b ) : x(b.x - a.x), y(b.y - a.y), z(b.z - a.z), w(0) {}
+#else
     //! constructeur par defaut.
-    Vector( const float _x= 0, const float _y= 0, const float _z= 0) : x(_x), y(_y), z(_z) {}
+    constexpr Vector( const float _x= 0, const float _y= 0, const float _z= 0) : x(_x), y(_y), z(_z) {}
     //! cree le vecteur ab.
-    Vector( const Point& a, const Point& b ) : x(b.x - a.x), y(b.y - a.y), z(b.z - a.z) {}
+    constexpr Vector( const Point& a, const Point& b ) : x(b.x - a.x), y(b.y - a.y), z(b.z - a.z) {}
+#endif
 
     //! cree un vecteur a partir des coordonnees du vecteur generique (v.x, v.y, v.z).
     explicit Vector( const vec3& v );   // l'implementation se trouve en fin de fichier, la structure vec3 n'est pas encore connue.
@@ -58,44 +81,47 @@ struct Vector
     float operator() ( const unsigned int i ) const; // l'implementation se trouve en fin de fichier
     
     float x, y, z;
+#ifdef GK_SSE
+    float w;    //!< bourrage, toujours 0.
+#endif
 };
 
 //! renvoie un vecteur unitaire / longueur == 1.
-Vector normalize( const Vector& v );
+inline Vector normalize( const Vector& v );
 //! renvoie le produit vectoriel de 2 vecteurs.
-Vector cross( const Vector& u, const Vector& v );
+inline Vector cross( const Vector& u, const Vector& v );
 //! renvoie le produit scalaire de 2 vecteurs.
-float dot( const Vector& u, const Vector& v );
+inline float dot( const Vector& u, const Vector& v );
 //! renvoie la longueur d'un vecteur.
-float length( const Vector& v );
+inline float length( const Vector& v );
 //! renvoie la carre de la longueur d'un vecteur.
-float length2( const Vector& v );
+inline float length2( const Vector& v );
 
 //! renvoie le vecteur a - b.
-Vector operator- ( const Point& a, const Point& b );
+inline Vector operator- ( const Point& a, const Point& b );
 //! renvoie le vecteur -v.
-Vector operator- ( const Vector& v );
+inline Vector operator- ( const Vector& v );
 
 //! renvoie le point a+v.
-Point operator+ ( const Point& a, const Vector& v );
+inline Point operator+ ( const Point& a, const Vector& v );
 //! renvoie le point a+v.
-Point operator+ ( const Vector& v, const Point& a );
+inline Point operator+ ( const Vector& v, const Point& a );
 //! renvoie le point a-v.
-Point operator- ( const Vector& v, const Point& a );
+inline Point operator- ( const Vector& v, const Point& a );
 //! renvoie le point a-v.
-Point operator- ( const Point& a, const Vector& v );
+inline Point operator- ( const Point& a, const Vector& v );
 //! renvoie le vecteur u+v.
-Vector operator+ ( const Vector& u, const Vector& v );
+inline Vector operator+ ( const Vector& u, const Vector& v );
 //! renvoie le vecteur u-v.
-Vector operator- ( const Vector& u, const Vector& v );
+inline Vector operator- ( const Vector& u, const Vector& v );
 //! renvoie le vecteur k*u;
-Vector operator* ( const float k, const Vector& v );
+inline Vector operator* ( const float k, const Vector& v );
 //! renvoie le vecteur k*v;
-Vector operator* ( const Vector& v, const float k );
+inline Vector operator* ( const Vector& v, const float k );
 //! renvoie le vecteur (a.x*b.x, a.y*b.y, a.z*b.z ).
-Vector operator* ( const Vector& a, const Vector& b );
+inline Vector operator* ( const Vector& a, const Vector& b );
 //! renvoie le vecteur v/k;
-Vector operator/ ( const Vector& v, const float k );
+inline Vector operator/ ( const Vector& v, const float k );
 
 
 //! vecteur generique, utilitaire.
@@ -145,11 +171,19 @@ struct vec4
 
 
 // implementation des constructeurs explicites.
+#ifdef GK_SSE
+inline Point::Point( const vec3& v ) : x(v.x), y(v.y), z(v.z), w(0) {}
+inline Point::Point( const Vector& v ) : x(v.x), y(v.y), z(v.z), w(0) {}
+
+inline Vector::Vector( const vec3& v ) : x(v.x), y(v.y), z(v.z), w(0) {}
+inline Vector::Vector( const Point& a ) : x(a.x), y(a.y), z(a.z), w(0) {}
+#else
 inline Point::Point( const vec3& v ) : x(v.x), y(v.y), z(v.z) {}
 inline Point::Point( const Vector& v ) : x(v.x), y(v.y), z(v.z) {}
 
 inline Vector::Vector( const vec3& v ) : x(v.x), y(v.y), z(v.z) {}
 inline Vector::Vector( const Point& a ) : x(a.x), y(a.y), z(a.z) {}
+#endif
 
 inline vec3::vec3( const Point& a ) : x(a.x), y(a.y), z(a.z) {}
 inline vec3::vec3( const Vector& v ) : x(v.x), y(v.y), z(v.z) {}
@@ -161,6 +195,56 @@ inline vec4::vec4( const Vector& v ) : x(v.x), y(v.y), z(v.z), w(0.f) {}
 inline float Point::operator( ) ( const unsigned int i ) const { return (&x)[i]; }
 inline float Vector::operator( ) ( const unsigned int i ) const { return (&x)[i]; }
 
+// implementation des operations.
+#include <cmath>
+
+#ifdef GK_SSE
+// chargement / stockage des 4 floats, w reste a 0 pour les operations lineaires.
+inline __m128 simd_load( const Point& a ) { return _mm_load_ps(&a.x); }
+inline __m128 simd_load( const Vector& v ) { return _mm_load_ps(&v.x); }
+inline Point simd_point( const __m128 m ) { Point p; _mm_store_ps(&p.x, m); return p; }
+inline Vector simd_vector( const __m128 m ) { Vector v; _mm_store_ps(&v.x, m); return v; }
+
+inline Vector operator- ( const Point& a, const Point& b ) { return simd_vector(_mm_sub_ps(simd_load(a), simd_load(b))); }
+inline Vector operator- ( const Vector& v ) { return simd_vector(_mm_xor_ps(simd_load(v), _mm_set1_ps(-0.f))); }
+inline Point operator+ ( const Point& a, const Vector& v ) { return simd_point(_mm_add_ps(simd_load(a), simd_load(v))); }
+inline Vector operator+ ( const Vector& u, const Vector& v ) { return simd_vector(_mm_add_ps(simd_load(u), simd_load(v))); }
+inline Vector operator- ( const Vector& u, const Vector& v ) { return simd_vector(_mm_sub_ps(simd_load(u), simd_load(v))); }
+inline Vector operator* ( const float k, const Vector& v ) { return simd_vector(_mm_mul_ps(_mm_set1_ps(k), simd_load(v))); }
+inline Vector operator* ( const Vector& a, const Vector& b ) { return simd_vector(_mm_mul_ps(simd_load(a), simd_load(b))); }
+#else
+inline Vector operator- ( const Point& a, const Point& b ) { return Vector(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vector operator- ( const Vector& v ) { return Vector(-v.x, -v.y, -v.z); }
+inline Point operator+ ( const Point& a, const Vector& v ) { return Point(a.x + v.x, a.y + v.y, a.z + v.z); }
+inline Vector operator+ ( const Vector& u, const Vector& v ) { return Vector(u.x + v.x, u.y + v.y, u.z + v.z); }
+inline Vector operator- ( const Vector& u, const Vector& v ) { return Vector(u.x - v.x, u.y - v.y, u.z - v.z); }
+inline Vector operator* ( const float k, const Vector& v ) { return Vector(k * v.x, k * v.y, k * v.z); }
+inline Vector operator* ( const Vector& a, const Vector& b ) { return Vector(a.x * b.x, a.y * b.y, a.z * b.z); }
+#endif
+
+inline Point operator+ ( const Vector& v, const Point& a ) { return a + v; }
+inline Point operator- ( const Vector& v, const Point& a ) { return a + (-v); }
+inline Point operator- ( const Point& a, const Vector& v ) { return a + (-v); }
+inline Vector operator* ( const Vector& v, const float k ) { return k * v; }
+inline Vector operator/ ( const Vector& v, const float k ) { float kk= 1 / k; return kk * v; }
+
+inline float dot( const Vector& u, const Vector& v ) { return u.x * v.x + u.y * v.y + u.z * v.z; }
+inline float length2( const Vector& v ) { return v.x * v.x + v.y * v.y + v.z * v.z; }
+inline float length( const Vector& v ) { return std::sqrt(length2(v)); }
+inline Vector normalize( const Vector& v ) { float kk= 1 / length(v); return kk * v; }
+
+inline Vector cross( const Vector& u, const Vector& v )
+{
+    return Vector(
+        (u.y * v.z) - (u.z * v.y),
+        (u.z * v.x) - (u.x * v.z),
+        (u.x * v.y) - (u.y * v.x));
+}
+
+inline float distance( const Point& a, const Point& b ) { return length(a - b); }
+inline float distance2( const Point& a, const Point& b ) { return length2(a - b); }
+inline Point center( const Point& a, const Point& b ) { return Point((a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f, (a.z + b.z) * 0.5f); }
+
 //
 #include <iostream>
 
@@ -1,7 +1,17 @@
 
 #include <cstdio>
+#include <cstdlib>
 #include <ctype.h>
 #include <climits>
+#include <string>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "wavefront.h"
 
@@ -37,143 +47,455 @@ struct MaterialLib
 MaterialLib read_materials( const char *filename );
 
 
-Mesh read_mesh( const char *filename )
+//! contenu d'un fichier, projete en memoire (mmap) ou copie si ce n'est pas possible.
+struct FileView
 {
-    FILE *in= fopen(filename, "rt");
+    const char *data;
+    size_t size;
+    std::vector<char> copy;
+#ifndef _WIN32
+    void *map;
+#endif
+};
+
+static
+bool open_view( const char *filename, FileView& view )
+{
+    view.data= NULL;
+    view.size= 0;
+#ifndef _WIN32
+    view.map= NULL;
+    int fd= open(filename, O_RDONLY);
+    if(fd < 0)
+        return false;
+    
+    struct stat info;
+    bool empty= false;
+    if(fstat(fd, &info) == 0)
+    {
+        empty= (info.st_size == 0);
+        void *map= empty ? MAP_FAILED : mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED)
+        {
+            view.map= map;
+            view.data= (const char *) map;
+            view.size= (size_t) info.st_size;
+        }
+    }
+    close(fd);
+    if(empty || view.map != NULL)
+        return true;
+#endif
+    
+    // pas de mmap, copie le fichier
+    FILE *in= fopen(filename, "rb");
     if(in == NULL)
+        return false;
+    char buffer[65536];
+    for(size_t n; (n= fread(buffer, 1, sizeof(buffer), in)) > 0; )
+        view.copy.insert(view.copy.end(), buffer, buffer + n);
+    fclose(in);
+    view.data= view.copy.empty() ? NULL : &view.copy.front();
+    view.size= view.copy.size();
+    return true;
+}
+
+static
+void close_view( FileView& view )
+{
+#ifndef _WIN32
+    if(view.map != NULL)
+        munmap(view.map, view.size);
+    view.map= NULL;
+#endif
+}
+
+
+//! lecteur d'entiers et de reels, meme grammaire que sscanf %d / %f, sans copie de la ligne.
+static
+bool is_space( const char c )
+{
+    return isspace((unsigned char) c) != 0;
+}
+
+static
+const char *skip_spaces( const char *s, const char *end )
+{
+    while(s < end && is_space(*s))
+        s++;
+    return s;
+}
+
+//! lit un entier, cf sscanf(" %d"). renvoie NULL en cas d'echec.
+static
+const char *parse_int( const char *s, const char *end, int& value )
+{
+    s= skip_spaces(s, end);
+    bool negative= false;
+    if(s < end && (*s == '-' || *s == '+'))
+        negative= (*s++ == '-');
+    if(s >= end || !isdigit((unsigned char) *s))
+        return NULL;
+    
+    int v= 0;
+    while(s < end && isdigit((unsigned char) *s))
+        v= v * 10 + (*s++ - '0');
+    value= negative ? -v : v;
+    return s;
+}
+
+//! lit un reel, cf sscanf(" %f"). renvoie NULL en cas d'echec.
+//! le cas courant est calcule exactement (mantisse < 2^24, puissance de 10 <= 10, une seule operation arrondie), sinon strtof( ).
+static
+const char *parse_float( const char *s, const char *end, float& value )
+{
+    static const float powers[]= { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+    
+    s= skip_spaces(s, end);
+    const char *start= s;
+    bool negative= false;
+    if(s < end && (*s == '-' || *s == '+'))
+        negative= (*s++ == '-');
+    
+    unsigned int m= 0;
+    int digits= 0;
+    int scale= 0;
+    bool exact= true;
+    for(; s < end && isdigit((unsigned char) *s); s++, digits++)
     {
-        printf("loading mesh '%s'... failed.\n", filename);
-        return Mesh::error();
+        m= m * 10 + (*s - '0');
+        exact= exact && m < (1u << 24);
     }
+    if(s < end && *s == '.')
+        for(s++; s < end && isdigit((unsigned char) *s); s++, digits++, scale++)
+        {
+            m= m * 10 + (*s - '0');
+            exact= exact && m < (1u << 24);
+        }
     
-    Mesh data(GL_TRIANGLES);
+    if(digits > 0 && s < end && (*s == 'e' || *s == 'E'))
+    {
+        int e;
+        const char *next= parse_int(s +1, end, e);
+        if(next != NULL && next > s +1 && !is_space(s[1]))
+        {
+            scale-= e;
+            s= next;
+        }
+    }
     
-    printf("loading mesh '%s'...\n", filename);
+    // hexadecimal, inf, nan, etc. ou pas assez precis : strtof
+    bool fast= exact && digits > 0 && scale >= -10 && scale <= 10 && !(s < end && (*s == 'x' || *s == 'X'));
+    if(!fast)
+    {
+        // strtof a besoin d'une chaine terminee par 0
+        char buffer[128];
+        size_t n= std::min((size_t) (end - start), sizeof(buffer) -1);
+        std::copy(start, start + n, buffer);
+        buffer[n]= 0;
+        char *last= NULL;
+        value= strtof(buffer, &last);
+        if(last == buffer)
+            return NULL;
+        return start + (last - buffer);
+    }
+    
+    float v= (scale >= 0) ? (float) m / powers[scale] : (float) m * powers[-scale];
+    value= negative ? -v : v;
+    return s;
+}
+
+//! lit n reels precedes du prefixe, cf sscanf("v %f %f %f").
+static
+bool parse_floats( const char *s, const char *end, const char *prefix, float *values, const int n )
+{
+    for(; *prefix; prefix++, s++)
+        if(s >= end || *s != *prefix)
+            return false;
+    
+    for(int i= 0; i < n; i++)
+        if((s= parse_float(s, end, values[i])) == NULL)
+            return false;
+    return true;
+}
+
+//! lit le nom qui suit le prefixe, cf sscanf("usemtl %[^\r\n]").
+static
+bool parse_name( const char *s, const char *end, const char *prefix, std::string& name )
+{
+    for(; *prefix; prefix++, s++)
+        if(s >= end || *s != *prefix)
+            return false;
+    
+    s= skip_spaces(s, end);
+    const char *last= s;
+    while(last < end && *last != '\r' && *last != '\n')
+        last++;
+    if(last == s)
+        return false;
+    
+    name.assign(s, last);
+    return true;
+}
+
+
+//! un sommet d'une face. les indices negatifs (relatifs a la fin des tableaux) sont stockes relativement au debut du morceau.
+struct ObjCorner
+{
+    int p, t, n;
+    unsigned char relative;     // bits 1, 2, 4 : p, t, n sont relatifs au debut du morceau
+};
+
+//! une commande a rejouer dans l'ordre du fichier : une face, un usemtl ou un mtllib.
+struct ObjCommand
+{
+    enum { FACE, USEMTL, MTLLIB } type;
+    unsigned int first;         // premier sommet de la face, ou indice du nom
+    unsigned int count;         // nombre de sommets de la face
+};
+
+//! resultat de l'analyse d'un morceau du fichier, compose de lignes completes.
+struct ObjChunk
+{
+    const char *begin;
+    const char *end;
     
     std::vector<vec3> positions;
     std::vector<vec2> texcoords;
     std::vector<vec3> normals;
-    std::vector<unsigned int> material_indices;
-    MaterialLib materials;
-    
-    std::vector<int> idp;
-    std::vector<int> idt;
-    std::vector<int> idn;
+    std::vector<ObjCorner> corners;
+    std::vector<ObjCommand> commands;
+    std::vector<std::string> names;
     
-    char tmp[1024];
-    char line_buffer[1024];
-    bool error= true;
+    const char *error;          // ligne qui n'a pas pu etre lue, ou NULL
+};
+
+//! lit les sommets d'une face, cf les formats " %d/%d/%d", " %d/%d", " %d//%d" et " %d". 
+static
+void parse_face( const char *s, const char *end, ObjChunk& chunk )
+{
+    ObjCommand command= { ObjCommand::FACE, (unsigned int) chunk.corners.size(), 0 };
     for(;;)
     {
-        // charge une ligne du fichier
-        if(fgets(line_buffer, sizeof(line_buffer), in) == NULL)
-        {
-            error= false;       // fin du fichier, pas d'erreur detectee
+        int p, t= 0, n= 0;
+        const char *next= parse_int(s, end, p);
+        if(next == NULL)
             break;
-        }
         
-        // force la fin de la ligne, au cas ou
-        line_buffer[sizeof(line_buffer) -1]= 0;
+        if(next < end && *next == '/')
+        {
+            if(next +1 < end && next[1] == '/')
+            {
+                // p//n, sinon seulement p
+                const char *last= parse_int(next +2, end, n);
+                if(last != NULL)
+                    next= last;
+                else
+                    n= 0;
+            }
+            else
+            {
+                // p/t/n ou p/t, sinon seulement p
+                const char *last= parse_int(next +1, end, t);
+                if(last != NULL)
+                {
+                    next= last;
+                    if(next < end && *next == '/')
+                    {
+                        last= parse_int(next +1, end, n);
+                        if(last != NULL)
+                            next= last;
+                        else
+                            n= 0;
+                    }
+                }
+                else
+                    t= 0;
+            }
+        }
+        s= skip_spaces(next, end);
         
-        // saute les espaces en debut de ligne
-        char *line= line_buffer;
-        while(*line && isspace(*line))
-            line++;
+        // meme convention que les tableaux : 0 invalide, < 0 relatif a la fin, sinon a partir de 1
+        ObjCorner corner;
+        corner.relative= (p < 0 ? 1 : 0) | (t < 0 ? 2 : 0) | (n < 0 ? 4 : 0);
+        corner.p= (p < 0) ? (int) chunk.positions.size() + p : p -1;
+        corner.t= (t < 0) ? (int) chunk.texcoords.size() + t : t -1;
+        corner.n= (n < 0) ? (int) chunk.normals.size()   + n : n -1;
+        chunk.corners.push_back(corner);
+        command.count++;
+    }
+    chunk.commands.push_back(command);
+}
+
+//! analyse toutes les lignes d'un morceau, s'arrete sur la premiere erreur.
+static
+void parse_chunk( ObjChunk& chunk )
+{
+    chunk.error= NULL;
+    for(const char *line_start= chunk.begin; line_start < chunk.end; )
+    {
+        const char *line_end= line_start;
+        while(line_end < chunk.end && *line_end != '\n')
+            line_end++;
         
-        if(line[0] == 'v')
+        const char *line= skip_spaces(line_start, line_end);
+        if(line < line_end && line[0] == 'v' && line +1 < line_end)
         {
-            float x, y, z;
+            float v[3];
             if(line[1] == ' ')          // position x y z
             {
-                if(sscanf(line, "v %f %f %f", &x, &y, &z) != 3)
+                if(!parse_floats(line, line_end, "v ", v, 3))
+                {
+                    chunk.error= line_start;
                     break;
-                positions.push_back( vec3(x, y, z) );
+                }
+                chunk.positions.push_back( vec3(v[0], v[1], v[2]) );
             }
             else if(line[1] == 'n')     // normal x y z
             {
-                if(sscanf(line, "vn %f %f %f", &x, &y, &z) != 3)
+                if(!parse_floats(line, line_end, "vn", v, 3))
+                {
+                    chunk.error= line_start;
                     break;
-                normals.push_back( vec3(x, y, z) );
+                }
+                chunk.normals.push_back( vec3(v[0], v[1], v[2]) );
             }
             else if(line[1] == 't')     // texcoord x y
             {
-                if(sscanf(line, "vt %f %f", &x, &y) != 2)
+                if(!parse_floats(line, line_end, "vt", v, 2))
+                {
+                    chunk.error= line_start;
                     break;
-                texcoords.push_back( vec2(x, y) );
+                }
+                chunk.texcoords.push_back( vec2(v[0], v[1]) );
             }
         }
         
-        else if(line[0] == 'f')         // triangle a b c, les sommets sont numerotes a partir de 1 ou de la fin du tableau (< 0)
+        else if(line < line_end && line[0] == 'f')
+            parse_face(line +1, line_end, chunk);
+        
+        else if(line_start[0] == 'm' || line_start[0] == 'u')
         {
-            idp.clear();
-            idt.clear();
-            idn.clear();
-            
-            int next;
-            for(line= line +1; ; line= line + next)
+            std::string name;
+            bool mtllib= (line_start[0] == 'm');
+            if(parse_name(line, line_end, mtllib ? "mtllib" : "usemtl", name))
             {
-                idp.push_back(0); 
-                idt.push_back(0); 
-                idn.push_back(0);         // 0: invalid index
-                
-                next= 0;
-                if(sscanf(line, " %d/%d/%d %n", &idp.back(), &idt.back(), &idn.back(), &next) == 3) 
-                    continue;
-                else if(sscanf(line, " %d/%d %n", &idp.back(), &idt.back(), &next) == 2)
-                    continue;
-                else if(sscanf(line, " %d//%d %n", &idp.back(), &idn.back(), &next) == 2)
-                    continue;
-                else if(sscanf(line, " %d %n", &idp.back(), &next) == 1)
-                    continue;
-                else if(next == 0)      // fin de ligne
-                    break;
+                ObjCommand command= { mtllib ? ObjCommand::MTLLIB : ObjCommand::USEMTL, (unsigned int) chunk.names.size(), 0 };
+                chunk.names.push_back(name);
+                chunk.commands.push_back(command);
             }
-            
-            for(int v= 2; v +1 < (int) idp.size(); v++)
+        }
+        
+        line_start= line_end +1;
+    }
+}
+
+
+Mesh read_mesh( const char *filename )
+{
+    FileView file;
+    if(!open_view(filename, file))
+    {
+        printf("loading mesh '%s'... failed.\n", filename);
+        return Mesh::error();
+    }
+    
+    Mesh data(GL_TRIANGLES);
+    
+    printf("loading mesh '%s'...\n", filename);
+    
+    // decoupe le fichier en morceaux de lignes completes, analyses en parallele
+    const size_t chunk_size= 1u << 20;
+    std::vector<ObjChunk> chunks;
+    for(size_t begin= 0; begin < file.size; )
+    {
+        size_t end= std::min(begin + chunk_size, file.size);
+        while(end < file.size && file.data[end -1] != '\n')
+            end++;
+        
+        chunks.push_back(ObjChunk());
+        chunks.back().begin= file.data + begin;
+        chunks.back().end= file.data + end;
+        begin= end;
+    }
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(int i= 0; i < (int) chunks.size(); i++)
+        parse_chunk(chunks[i]);
+    
+    // les morceaux sont rejoues dans l'ordre du fichier, jusqu'a la premiere erreur
+    size_t count= 0;
+    while(count < chunks.size() && chunks[count++].error == NULL)
+        {}
+    
+    std::vector<vec3> positions;
+    std::vector<vec2> texcoords;
+    std::vector<vec3> normals;
+    std::vector<int> first_position(count), first_texcoord(count), first_normal(count);
+    for(size_t c= 0; c < count; c++)
+    {
+        first_position[c]= (int) positions.size();
+        first_texcoord[c]= (int) texcoords.size();
+        first_normal[c]= (int) normals.size();
+        positions.insert(positions.end(), chunks[c].positions.begin(), chunks[c].positions.end());
+        texcoords.insert(texcoords.end(), chunks[c].texcoords.begin(), chunks[c].texcoords.end());
+        normals.insert(normals.end(), chunks[c].normals.begin(), chunks[c].normals.end());
+    }
+    
+    MaterialLib materials;
+    for(size_t c= 0; c < count; c++)
+    {
+        const ObjChunk& chunk= chunks[c];
+        for(size_t k= 0; k < chunk.commands.size(); k++)
+        {
+            const ObjCommand& command= chunk.commands[k];
+            if(command.type == ObjCommand::FACE)
             {
-                int idv[3]= { 0, v -1, v };
-                for(int i= 0; i < 3; i++)
+                const ObjCorner *corners= &chunk.corners[command.first];
+                for(int v= 2; v < (int) command.count; v++)
                 {
-                    int k= idv[i];
-                    int p= (idp[k] < 0) ? (int) positions.size() + idp[k] : idp[k] -1;
-                    int t= (idt[k] < 0) ? (int) texcoords.size() + idt[k] : idt[k] -1;
-                    int n= (idn[k] < 0) ? (int) normals.size()   + idn[k] : idn[k] -1;
-                    
-                    if(p < 0) break; // error
-                    if(t >= 0) data.texcoord(texcoords[t]);
-                    if(n >= 0) data.normal(normals[n]);
-                    data.vertex(positions[p]);
+                    int idv[3]= { 0, v -1, v };
+                    for(int i= 0; i < 3; i++)
+                    {
+                        const ObjCorner& corner= corners[idv[i]];
+                        int p= (corner.relative & 1) ? first_position[c] + corner.p : corner.p;
+                        int t= (corner.relative & 2) ? first_texcoord[c] + corner.t : corner.t;
+                        int n= (corner.relative & 4) ? first_normal[c] + corner.n : corner.n;
+                        
+                        if(p < 0) break; // error
+                        if(t >= 0) data.texcoord(texcoords[t]);
+                        if(n >= 0) data.normal(normals[n]);
+                        data.vertex(positions[p]);
+                    }
                 }
             }
+            
+            else if(command.type == ObjCommand::MTLLIB)
+            {
+                materials= read_materials( std::string(pathname(filename) + chunk.names[command.first]).c_str() );
+                // enregistre les matieres dans le mesh
+                data.mesh_materials(materials.data);
+            }
+            
+            else
+            {
+                for(size_t i= 0; i < materials.names.size(); i++)
+                    if(materials.names[i] == chunk.names[command.first])
+                        // selectionne une matiere pour le prochain triangle
+                        data.material(i);
+            }
         }
         
-        else if(line_buffer[0] == 'm')
-        {
-           if(sscanf(line, "mtllib %[^\r\n]", tmp) == 1)
-           {
-               materials= read_materials( std::string(pathname(filename) + tmp).c_str() );
-               // enregistre les matieres dans le mesh
-               data.mesh_materials(materials.data);
-           }
-        }
-        
-        else if(line_buffer[0] == 'u')
+        if(chunk.error != NULL)
         {
-           if(sscanf(line, "usemtl %[^\r\n]", tmp) == 1)
-           {
-               for(size_t i= 0; i < materials.names.size(); i++)
-                if(materials.names[i] == tmp)
-                    // selectionne une matiere pour le prochain triangle
-                    data.material(i);
-           }
+            const char *end= chunk.error;
+            while(end < chunk.end && *end != '\n')
+                end++;
+            printf("loading mesh '%s'...\n[error]\n%s\n\n", filename, std::string(chunk.error, end).c_str());
         }
     }
     
-    fclose(in);
-    
-    if(error)
-        printf("loading mesh '%s'...\n[error]\n%s\n\n", filename, line_buffer);
-    
+    close_view(file);
     return data;
 }
 
@@ -0,0 +1,74 @@
+/**
+ * @file BoundingBox.hpp
+ * @brief La boite englobante alignée sur les axes des BVH.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef BOUNDINGBOX_HPP_INCLUDED
+#define BOUNDINGBOX_HPP_INCLUDED
+
+#include <algorithm>
+#include <cfloat>
+#include "../core/gkit_core.hpp"
+#include "Triangle.hpp"
+
+/**
+ * @struct BoundingBox
+ * @brief Une boite alignée sur les axes, vide (pmin > pmax) à la construction.
+ */
+struct BoundingBox final
+{
+    vec3 pmin; //!< Le point minimale.
+    vec3 pmax; //!< Le point maximale.
+
+    BoundingBox(void) : pmin(FLT_MAX, FLT_MAX, FLT_MAX), pmax(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+    /**
+     * @brief Agrandit la boite pour contenir @b p.
+     * @param[in] p Le point à inclure.
+     */
+    void insert(const vec3& p) noexcept
+    {
+        this->pmin = vec3(std::min(this->pmin.x, p.x), std::min(this->pmin.y, p.y), std::min(this->pmin.z, p.z));
+        this->pmax = vec3(std::max(this->pmax.x, p.x), std::max(this->pmax.y, p.y), std::max(this->pmax.z, p.z));
+    }
+    /**
+     * @brief Agrandit la boite pour contenir @b other.
+     * @param[in] other La boite à inclure.
+     */
+    void insert(const BoundingBox& other) noexcept
+    {
+        this->insert(other.pmin);
+        this->insert(other.pmax);
+    }
+    //! Renvoie le centre de la boite.
+    vec3 center(void) const noexcept
+    {
+        return vec3((this->pmin.x + this->pmax.x)/2.0f, (this->pmin.y + this->pmax.y)/2.0f,
+                    (this->pmin.z + this->pmax.z)/2.0f);
+    }
+    //! Renvoie l'aire de la surface de la boite, 0 si elle est vide.
+    float area(void) const noexcept
+    {
+        const float dx = this->pmax.x - this->pmin.x, dy = this->pmax.y - this->pmin.y, dz = this->pmax.z - this->pmin.z;
+        return (dx < 0.0f || dy < 0.0f || dz < 0.0f) ? 0.0f : 2.0f*(dx*dy + dy*dz + dz*dx);
+    }
+    /**
+     * @brief Vérifie si @b ray traverse la boite avant @b tmax (test des dalles).
+     * @param[in]  ray     Le rayon avec lequel tester.
+     * @param[in]  inverse L'inverse composante par composante de ray.d.
+     * @param[in]  tmax    L'abscisse maximale acceptée.
+     * @param[out] tnear   L'abscisse d'entrée dans la boite, 0 si l'origine est dedans.
+     * @return true si @b ray intersecte la boite, false sinon.
+     */
+    bool intersect(const Ray& ray, const Vector& inverse, float tmax, float& tnear) const noexcept
+    {
+        const float x0 = (this->pmin.x - ray.o.x)*inverse.x, x1 = (this->pmax.x - ray.o.x)*inverse.x;
+        const float y0 = (this->pmin.y - ray.o.y)*inverse.y, y1 = (this->pmax.y - ray.o.y)*inverse.y;
+        const float z0 = (this->pmin.z - ray.o.z)*inverse.z, z1 = (this->pmax.z - ray.o.z)*inverse.z;
+        tnear = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+        const float tfar = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), tmax));
+        return tnear <= tfar;
+    }
+};
+
+#endif
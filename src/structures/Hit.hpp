@@ -17,8 +17,9 @@ struct Hit
     float t;	    //!< t, abscisse sur le rayon.
     float u, v;	    //!< u, v coordonnees barycentrique dans le triangle.
     int object_id;  //! indice du triangle dans le maillage.
+    int instance;   //!< indice de l'instance dans Scene::instances, -1 pour un triangle de la scène de base.
     
-    Hit( ) : p(), n(), t(FLT_MAX), u(0), v(0), object_id(-1) {}
+    Hit( ) : p(), n(), t(FLT_MAX), u(0), v(0), object_id(-1), instance(-1) {}
 };
 
 #endif
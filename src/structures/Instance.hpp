@@ -0,0 +1,44 @@
+/**
+ * @file Instance.hpp
+ * @brief Une copie placée d'un mesh partagé, feuille du BVH des instances.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef INSTANCE_HPP_INCLUDED
+#define INSTANCE_HPP_INCLUDED
+
+#include "../core/gkit_core.hpp"
+#include "BoundingBox.hpp"
+
+/**
+ * @struct InstancedMesh
+ * @brief Un mesh chargé une seule fois : ses triangles, dans le repère de l'objet, sont
+ * Scene::instanceTriangles[first, first + count), dans l'ordre de son BVH Scene::blas[i].
+ */
+struct InstancedMesh final
+{
+    unsigned int first; //!< Le premier triangle dans Scene::instanceTriangles.
+    unsigned int count; //!< Le nombre de triangles.
+
+    InstancedMesh(void) : first(0), count(0) {}
+};
+
+/**
+ * @struct Instance
+ * @brief Un InstancedMesh placé dans la scène par une transformation.
+ * @details Les rayons sont ramenés dans le repère de l'objet sans normaliser leur direction,
+ * l'abscisse t d'un impact y est donc la meme que dans le repère de la scène.
+ */
+struct Instance final
+{
+    Transform   toWorld;  //!< Du repère de l'objet vers celui de la scène.
+    Transform   toObject; //!< L'inverse de toWorld, appliquée aux rayons.
+    Transform   normals;  //!< L'inverse transposée de toWorld, appliquée aux normales.
+    BoundingBox bbox;     //!< La boite du mesh transformé, dans le repère de la scène.
+    int         mesh;     //!< L'indice du mesh dans Scene::meshes et Scene::blas.
+    int         rank;     //!< Sa place dans scene.xml, qui ne dépend pas de l'ordre du BVH des instances.
+
+    Instance(void) : toWorld(), toObject(), normals(), bbox(), mesh(0), rank(0) {}
+};
+
+#endif
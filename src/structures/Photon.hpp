@@ -0,0 +1,75 @@
+/**
+ * @file Photon.hpp
+ * @brief Un photon déposé sur la géométrie par PhotonMap.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef PHOTON_HPP_INCLUDED
+#define PHOTON_HPP_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+
+#include "../core/gkit_core.hpp"
+
+/**
+ * @struct Photon
+ * @brief Un noeud du kd-tree de PhotonMap, qui est aussi le photon lui-meme.
+ * @details Occupe exactement 32 octets, soit deux photons par ligne de cache.
+ * La normale de la surface touchée est quantifiée sur un octet signé par composante.
+ */
+struct Photon final
+{
+    Point   position;  //!< Le point où le photon a été déposé.
+    float   power[3];  //!< Le flux transporté, en rgb.
+    int8_t  normal[3]; //!< La normale de la surface, tournée vers le photon arrivant, multipliée par 127.
+    uint8_t axis;      //!< L'axe de coupe du noeud dans le kd-tree, 0 pour x, 1 pour y, 2 pour z.
+    char    padding[4];//!< Complète le photon à 32 octets.
+
+    /**
+     * @brief Crée un photon.
+     * @param[in] p     Le point d'impact.
+     * @param[in] n     La normale en ce point, normalisée.
+     * @param[in] flux  Le flux transporté.
+     * @return Le photon, son axe restant à fixer par la construction du kd-tree.
+     */
+    static Photon make(const Point& p, const Vector& n, const Color& flux) noexcept
+    {
+        const auto quantize = [](float c) -> int8_t {
+            return static_cast<int8_t>(std::lround(std::fmin(std::fmax(c, -1.0f), 1.0f)*127.0f));
+        };
+        Photon photon;
+        photon.position  = p;
+        photon.power[0]  = flux.r;
+        photon.power[1]  = flux.g;
+        photon.power[2]  = flux.b;
+        photon.normal[0] = quantize(n.x);
+        photon.normal[1] = quantize(n.y);
+        photon.normal[2] = quantize(n.z);
+        photon.axis      = 0;
+        photon.padding[0] = photon.padding[1] = photon.padding[2] = photon.padding[3] = 0;
+        return photon;
+    }
+    /**
+     * @brief Donne une coordonnée de la position.
+     * @param[in] axis L'axe voulu.
+     * @return La coordonnée.
+     */
+    float coordinate(int axis) const noexcept
+    {
+        return (axis == 0) ? this->position.x : ((axis == 1) ? this->position.y : this->position.z);
+    }
+    /**
+     * @brief Le produit scalaire de la normale du photon avec @b n.
+     * @param[in] n Une normale, normalisée.
+     * @return Le cosinus entre les deux normales, à la quantification près.
+     */
+    float facing(const Vector& n) const noexcept
+    {
+        return (this->normal[0]*n.x + this->normal[1]*n.y + this->normal[2]*n.z)/127.0f;
+    }
+};
+
+static_assert(sizeof(Photon) == 32, "Photon doit occuper la moitié d'une ligne de cache");
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file ShadingMaterial.hpp
+ * @brief Une matière prête pour Blinn-Phong, avec ses termes constants déjà calculés.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef SHADINGMATERIAL_HPP_INCLUDED
+#define SHADINGMATERIAL_HPP_INCLUDED
+
+#include <cmath>
+
+#include "../core/gkit_core.hpp"
+#include "../core/math_core.hpp"
+
+/**
+ * @struct ShadingMaterial
+ * @brief Une entrée de la table Scene::materials, indexée par Triangle::material.
+ * @details Occupe exactement 64 octets, soit une ligne de cache, pour que la table
+ * reste dense et qu'une matière ne soit jamais lue en deux fois.
+ */
+struct ShadingMaterial final
+{
+    Color diffuse;       //!< L'albédo diffus, déjà multiplié par coef.
+    Color specular;      //!< La couleur du reflet, déjà multipliée par (1 - coef).
+    Color emission;      //!< Le flux émis, pour les sources.
+    float ns;            //!< L'exposant du reflet.
+    float normalization; //!< (ns+1)/(2pi), la normalisation du lobe spéculaire.
+    bool  fastLobe;      //!< Si fastPow respecte la tolérance demandée pour cet ns.
+    char  padding[7];    //!< Complète l'entrée à 64 octets.
+
+    /**
+     * @brief Prépare une matière du mesh pour le rendu.
+     * @param[in] material  La matière lue dans le .mtl.
+     * @param[in] coef      Le coefficient de répartition pour l'albédo (RaytracingXml::interpolation).
+     * @param[in] tolerance L'erreur relative acceptée sur le lobe spéculaire, 0 pour toujours utiliser std::pow.
+     * @return La matière avec ses termes pondérés.
+     */
+    static ShadingMaterial build(const Material& material, float coef, float tolerance) noexcept
+    {
+        ShadingMaterial result;
+        result.diffuse       = coef*material.diffuse;
+        result.specular      = (1.0f-coef)*material.specular;
+        result.emission      = material.emission;
+        result.ns            = material.ns;
+        result.normalization = (material.ns + 1.0f)/(2.0f*M_PI);
+        result.fastLobe      = (tolerance > 0.0f) && (fastPowError(material.ns) <= tolerance);
+        std::memset(result.padding, 0, sizeof(result.padding));
+        return result;
+    }
+};
+
+static_assert(sizeof(ShadingMaterial) == 64, "ShadingMaterial doit occuper une ligne de cache");
+
+#endif
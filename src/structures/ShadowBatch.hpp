@@ -0,0 +1,121 @@
+/**
+ * @file ShadowBatch.hpp
+ * @brief Le tampon des rayons d'ombre d'un point d'impact.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef SHADOWBATCH_HPP_INCLUDED
+#define SHADOWBATCH_HPP_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include "../core/gkit_core.hpp"
+#include "../core/ray_core.hpp"
+
+/**
+ * @class ShadowBatch
+ * @brief Un tampon réutilisable des rayons d'ombre générés pour un point d'impact.
+ * @details Les échantillons sont rangés en SoA pour que l'évaluation de la BRDF soit une simple boucle.
+ */
+class ShadowBatch final
+{
+    public:
+        std::vector<Ray>    rays;    //!< Les rayons d'ombre, partant du point d'impact décalé.
+        std::vector<Point>  points;  //!< Le point visé sur la source par chaque rayon.
+        std::vector<Vector> normals; //!< La normale de la source en ce point.
+        unsigned int        visible; //!< Le nombre d'échantillons non occultés, rangés en tête après trace().
+        unsigned int        traced;  //!< Le nombre de rayons réellement lancés depuis clear(), caches compris.
+
+        ShadowBatch(void) : rays(), points(), normals(), visible(0), traced(0){}
+        /**
+         * @brief Vide le tampon sans rendre la mémoire, pour le prochain point d'impact.
+         */
+        void clear(void) noexcept
+        {
+            this->rays.clear();
+            this->points.clear();
+            this->normals.clear();
+            this->visible = 0;
+            this->traced  = 0;
+        }
+        /**
+         * @brief Ajoute un échantillon au tampon.
+         * @param[in] ray    Le rayon d'ombre à lancer.
+         * @param[in] e      Le point visé sur la source.
+         * @param[in] normal La normale de la source en @b e.
+         */
+        void push(const Ray& ray, const Point& e, const Vector& normal)
+        {
+            this->rays.push_back(ray);
+            this->points.push_back(e);
+            this->normals.push_back(normal);
+        }
+        /**
+         * @brief Lance tous les rayons du tampon en un appel.
+         * @details Les échantillons non occultés sont déplacés en tête, dans leur ordre d'origine.
+         * @return Le nombre d'échantillons non occultés.
+         */
+        unsigned int trace(void)
+        {
+            return this->select([this](unsigned int i){
+                return !this->occluded(i);
+            });
+        }
+        /**
+         * @brief Comme trace(), en notant la visibilité de chaque échantillon.
+         * @param[out] mask Un bit par échantillon, dans l'ordre de génération, à 1 s'il n'est pas occulté.
+         * @return Le nombre d'échantillons non occultés.
+         */
+        unsigned int trace(std::vector<uint64_t>& mask)
+        {
+            mask.assign((this->size() + 63)/64, 0);
+            return this->select([this, &mask](unsigned int i){
+                const bool visible = !this->occluded(i);
+                mask[i >> 6] |= static_cast<uint64_t>(visible) << (i & 63);
+                return visible;
+            });
+        }
+        /**
+         * @brief Lance le rayon d'un échantillon, en le comptant dans @b traced.
+         * @param[in] i L'indice de l'échantillon.
+         * @return true si le rayon est occulté.
+         */
+        bool occluded(unsigned int i)
+        {
+            ++this->traced;
+            return Scene::occluded(this->rays[i]);
+        }
+        //! Renvoie le nombre d'échantillons générés.
+        unsigned int size(void) const noexcept
+        {
+            return this->rays.size();
+        }
+        /**
+         * @brief Remplace trace() : déplace en tete les échantillons pour lesquels @b visible est vrai.
+         * @tparam Visible Un appelable bool(unsigned int i), appelé une fois par échantillon dans l'ordre,
+         * avant que l'échantillon i ne soit déplacé.
+         * @return Le nombre d'échantillons gardés.
+         */
+        template<typename Visible>
+        unsigned int select(Visible visible)
+        {
+            unsigned int kept = 0;
+            for(unsigned int i=0;i<this->size();++i)
+            {
+                if (visible(i))
+                {
+                    if (kept != i)
+                    {
+                        this->rays[kept]    = this->rays[i];
+                        this->points[kept]  = this->points[i];
+                        this->normals[kept] = this->normals[i];
+                    }
+                    ++kept;
+                }
+            }
+            this->visible = kept;
+            return kept;
+        }
+};
+
+#endif
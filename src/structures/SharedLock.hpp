@@ -0,0 +1,95 @@
+/**
+ * @file SharedLock.hpp
+ * @brief Un verrou partagé entre lecteurs, exclusif pour un écrivain.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef SHAREDLOCK_HPP_INCLUDED
+#define SHAREDLOCK_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+/**
+ * @struct SharedLock
+ * @brief Les lecteurs avancent ensemble, un écrivain attend qu'ils sortent et bloque les nouveaux.
+ * @details std::shared_mutex n'existe pas en C++11. Ici l'état tient dans un seul entier atomique :
+ * le bit de poids fort marque un écrivain, en attente ou actif, et les autres comptent les lecteurs.
+ * Les attentes cèdent le processeur plutot que de dormir, les sections protégées étant courtes.
+ */
+struct SharedLock final
+{
+    SharedLock(void) : state(0) {}
+    SharedLock(const SharedLock&)            = delete;
+    SharedLock& operator=(const SharedLock&) = delete;
+
+    //! Entre en lecture, une fois aucun écrivain en attente ni actif.
+    void lock_shared(void) noexcept
+    {
+        for(;;)
+        {
+            uint32_t current = this->state.load(std::memory_order_relaxed);
+            if (!(current & WRITER)
+                && this->state.compare_exchange_weak(current, current + 1, std::memory_order_acquire))
+            {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+    //! Sort de lecture.
+    void unlock_shared(void) noexcept
+    {
+        this->state.fetch_sub(1, std::memory_order_release);
+    }
+    //! Entre en écriture : réserve le verrou, puis attend la sortie des lecteurs déjà entrés.
+    void lock(void) noexcept
+    {
+        for(;;)
+        {
+            uint32_t current = this->state.load(std::memory_order_relaxed);
+            if (!(current & WRITER)
+                && this->state.compare_exchange_weak(current, current | WRITER, std::memory_order_relaxed))
+            {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        while(this->state.load(std::memory_order_acquire) != WRITER)
+        {
+            std::this_thread::yield();
+        }
+    }
+    //! Sort d'écriture.
+    void unlock(void) noexcept
+    {
+        this->state.store(0, std::memory_order_release);
+    }
+
+    /**
+     * @struct Reader
+     * @brief Garde une lecture le temps d'une portée, à la manière de std::lock_guard.
+     */
+    struct Reader final
+    {
+        explicit Reader(SharedLock& lock) noexcept : lock(lock)
+        {
+            this->lock.lock_shared();
+        }
+        ~Reader(void)
+        {
+            this->lock.unlock_shared();
+        }
+        Reader(const Reader&)            = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        SharedLock& lock; //!< Le verrou tenu.
+    };
+
+    private:
+        static constexpr uint32_t WRITER = 0x80000000u; //!< Le bit d'un écrivain en attente ou actif.
+        std::atomic<uint32_t>     state;                //!< Le bit WRITER et le nombre de lecteurs.
+};
+
+#endif
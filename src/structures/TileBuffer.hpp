@@ -0,0 +1,163 @@
+/**
+ * @file TileBuffer.hpp
+ * @brief L'image en cours de rendu, en tuiles parcourues dans l'ordre de Morton.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef TILEBUFFER_HPP_INCLUDED
+#define TILEBUFFER_HPP_INCLUDED
+
+#include <cstddef>
+#include <vector>
+#include "../core/gkit_core.hpp"
+
+#define TILE_SIZE   16                    //!< Le coté d'une tuile, en pixels.
+#define TILE_PIXELS (TILE_SIZE*TILE_SIZE) //!< Le nombre de pixels d'une tuile.
+
+/**
+ * @struct TileBuffer
+ * @brief La luminance linéaire de l'image en cours de rendu, par bandes de TILE_SIZE lignes découpées en tuiles carrées.
+ * @details Chaque tuile occupe TILE_PIXELS*3 float contigus (r, g, b sans alpha, soit 3 Ko),
+ * ses pixels rangés dans l'ordre de Morton : des pixels voisins à l'écran sont voisins en mémoire,
+ * et les rayons lancés l'un après l'autre restent proches dans la scène. Une bande est un bloc
+ * contigu de bandSize() float, que les tuiles du bord de l'image soient pleines ou non.
+ * L'Image RGBA n'est construite qu'à la sortie (cf image), ou ligne à ligne pour qui en a besoin (cf resolve).
+ */
+struct TileBuffer final
+{
+    int                width;  //!< La largeur de l'image.
+    int                height; //!< La hauteur de l'image.
+    std::vector<float> rgb;    //!< Les bandes, de bas en haut, chacune de gauche à droite.
+
+    /**
+     * @brief Crée un tampon noir.
+     * @param[in] w La largeur de l'image.
+     * @param[in] h La hauteur de l'image.
+     */
+    TileBuffer(int w, int h) : width(w), height(h), rgb()
+    {
+        this->rgb.assign(static_cast<std::size_t>(this->bands())*this->bandSize(), 0.0f);
+    }
+    //! Renvoie le nombre de tuiles d'une bande.
+    int tiles(void) const noexcept
+    {
+        return (this->width + TILE_SIZE - 1)/TILE_SIZE;
+    }
+    //! Renvoie le nombre de bandes de l'image.
+    int bands(void) const noexcept
+    {
+        return (this->height + TILE_SIZE - 1)/TILE_SIZE;
+    }
+    //! Renvoie le nombre de float d'une bande.
+    std::size_t bandSize(void) const noexcept
+    {
+        return static_cast<std::size_t>(this->tiles())*TILE_PIXELS*3;
+    }
+    //! Renvoie les bandSize() float de la bande @b band.
+    float* band(int band) noexcept
+    {
+        return this->rgb.data() + band*this->bandSize();
+    }
+    //! Renvoie les bandSize() float de la bande @b band.
+    const float* band(int band) const noexcept
+    {
+        return this->rgb.data() + band*this->bandSize();
+    }
+    /**
+     * @brief Donne le pixel d'indice de Morton @b m dans la tuile @b tile d'une bande.
+     * @param[in]  tile La tuile.
+     * @param[in]  m    L'indice de Morton, dans [0, TILE_PIXELS).
+     * @param[in]  rows Le nombre de lignes de la bande.
+     * @param[out] x    La colonne dans l'image.
+     * @param[out] y    La ligne dans la bande.
+     * @return false si le pixel sort de l'image (tuile du bord droit, dernière bande).
+     */
+    bool pixel(int tile, int m, int rows, int& x, int& y) const noexcept
+    {
+        x = tile*TILE_SIZE + compact(m);
+        y = compact(m >> 1);
+        return x < this->width && y < rows;
+    }
+    /**
+     * @brief Range la luminance du pixel d'indice de Morton @b m de la tuile @b tile.
+     * @param[in] band  La bande.
+     * @param[in] tile  La tuile.
+     * @param[in] m     L'indice de Morton.
+     * @param[in] color La luminance.
+     */
+    void store(int band, int tile, int m, const Color& color) noexcept
+    {
+        float* p = this->band(band) + (static_cast<std::size_t>(tile)*TILE_PIXELS + m)*3;
+        p[0] = color.r;
+        p[1] = color.g;
+        p[2] = color.b;
+    }
+    /**
+     * @brief Recopie les lignes [y0, y1) en RGBA, ligne par ligne, avec un alpha de 1.
+     * @param[out] rows Les (y1 - y0)*width pixels, la ligne y commençant à rows + (y - y0)*width.
+     * @param[in]  y0   La première ligne.
+     * @param[in]  y1   La ligne suivant la dernière.
+     */
+    void resolve(Color* rows, int y0, int y1) const noexcept
+    {
+        for(int y=y0;y<y1;++y)
+        {
+            const float* band = this->band(y/TILE_SIZE);
+            const int    my   = spread(y % TILE_SIZE) << 1;
+            Color*       row  = rows + static_cast<std::size_t>(y - y0)*this->width;
+            for(int x=0;x<this->width;++x)
+            {
+                const float* p = band + (static_cast<std::size_t>(x/TILE_SIZE)*TILE_PIXELS
+                                         + (spread(x % TILE_SIZE) | my))*3;
+                row[x] = Color(p[0], p[1], p[2], 1.0f);
+            }
+        }
+    }
+    /**
+     * @brief Construit l'Image RGBA de tout le tampon, pour les sorties.
+     * @return L'image, en luminance linéaire.
+     */
+    Image image(void) const
+    {
+        Image result(this->width, this->height);
+        if (result.size() == 0)
+        {
+            return result;
+        }
+        Color* pixels = &result(0, 0);
+        #pragma omp parallel for schedule(static)
+        for(int band=0;band<this->bands();++band)
+        {
+            const int y0 = band*TILE_SIZE;
+            const int y1 = (y0 + TILE_SIZE < this->height) ? y0 + TILE_SIZE : this->height;
+            this->resolve(pixels + static_cast<std::size_t>(y0)*this->width, y0, y1);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Garde un bit sur deux de @b m, l'inverse de spread.
+     * @param[in] m Les bits entrelacés, ceux de rang pair sont gardés.
+     * @return La coordonnée, dans [0, TILE_SIZE).
+     */
+    static int compact(int m) noexcept
+    {
+        m &= 0x55;
+        m = (m | (m >> 1)) & 0x33;
+        return (m | (m >> 2)) & 0x0F;
+    }
+    /**
+     * @brief Intercale un zéro entre chaque bit de @b v.
+     * @param[in] v La coordonnée, dans [0, TILE_SIZE).
+     * @return Les bits de @b v aux rangs pairs.
+     */
+    static int spread(int v) noexcept
+    {
+        v = (v | (v << 2)) & 0x33;
+        return (v | (v << 1)) & 0x55;
+    }
+};
+
+static_assert(TILE_SIZE == 16, "compact et spread entrelacent des coordonnées sur 4 bits");
+
+#endif
@@ -5,6 +5,8 @@
 #ifndef TRIANGLE_HPP_INCLUDED
 #define TRIANGLE_HPP_INCLUDED
 
+#include <cstdint>
+
 #include "../core/gkit_core.hpp"
 #include "../core/math_core.hpp"
 
@@ -25,8 +27,10 @@ struct Ray
 
 struct Triangle : public TriangleData
 {
-    Triangle( ) : TriangleData() {}
-    Triangle( const TriangleData& data ) : TriangleData(data) {}
+    uint16_t material;  //!< indice de la matiere dans Scene::materials.
+
+    Triangle( ) : TriangleData(), material(0) {}
+    Triangle( const TriangleData& data, const uint16_t id= 0 ) : TriangleData(data), material(id) {}
     
     /* calcule l'intersection ray/triangle
         cf "fast, minimum storage ray-triangle intersection" 
@@ -105,7 +109,7 @@ struct Source : public Triangle
     Color emission;     //! flux emis.
     
     Source( ) : Triangle(), emission() {}
-    Source( const TriangleData& data, const Color& color ) : Triangle(data), emission(color) {}
+    Source( const Triangle& triangle, const Color& color ) : Triangle(triangle), emission(color) {}
     
     /**
 	 * @brief      
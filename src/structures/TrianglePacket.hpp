@@ -0,0 +1,212 @@
+/**
+ * @file TrianglePacket.hpp
+ * @brief Des paquets de triangles en SoA, intersectés par un seul rayon en SIMD.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
+#ifndef TRIANGLEPACKET_HPP_INCLUDED
+#define TRIANGLEPACKET_HPP_INCLUDED
+
+#include <vector>
+#include "../core/gkit_core.hpp"
+#include "../core/math_core.hpp"
+#include "Triangle.hpp"
+
+// PACKET_WIDTH n'est défini que si une version SIMD est disponible (8 avec AVX, 4 avec SSE).
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define PACKET_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define PACKET_WIDTH 4
+#endif
+
+#ifdef PACKET_WIDTH
+
+/**
+ * @brief Les quelques opérations SIMD utilisées par le noyau, pour la largeur choisie.
+ */
+namespace packet
+{
+#if PACKET_WIDTH == 8
+    typedef __m256 lanes_t;
+    inline lanes_t set1(float f) noexcept                   { return _mm256_set1_ps(f); }
+    inline lanes_t load(const float* p) noexcept            { return _mm256_loadu_ps(p); }
+    inline void    store(float* p, lanes_t a) noexcept      { _mm256_storeu_ps(p, a); }
+    inline lanes_t add(lanes_t a, lanes_t b) noexcept       { return _mm256_add_ps(a, b); }
+    inline lanes_t sub(lanes_t a, lanes_t b) noexcept       { return _mm256_sub_ps(a, b); }
+    inline lanes_t mul(lanes_t a, lanes_t b) noexcept       { return _mm256_mul_ps(a, b); }
+    inline lanes_t div(lanes_t a, lanes_t b) noexcept       { return _mm256_div_ps(a, b); }
+    inline lanes_t min(lanes_t a, lanes_t b) noexcept       { return _mm256_min_ps(a, b); }
+    inline lanes_t land(lanes_t a, lanes_t b) noexcept      { return _mm256_and_ps(a, b); }
+    inline lanes_t lor(lanes_t a, lanes_t b) noexcept       { return _mm256_or_ps(a, b); }
+    inline lanes_t ge(lanes_t a, lanes_t b) noexcept        { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    inline lanes_t le(lanes_t a, lanes_t b) noexcept        { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    inline lanes_t gt(lanes_t a, lanes_t b) noexcept        { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline lanes_t eq(lanes_t a, lanes_t b) noexcept        { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    inline int     mask(lanes_t a) noexcept                 { return _mm256_movemask_ps(a); }
+    //! Renvoie @b a là où @b m est vrai, @b b sinon.
+    inline lanes_t select(lanes_t m, lanes_t a, lanes_t b) noexcept { return _mm256_blendv_ps(b, a, m); }
+    //! Renvoie le minimum des 8 voies, dans chaque voie.
+    inline lanes_t hmin(lanes_t a) noexcept
+    {
+        a = _mm256_min_ps(a, _mm256_permute2f128_ps(a, a, 1));
+        a = _mm256_min_ps(a, _mm256_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm256_min_ps(a, _mm256_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+#else
+    typedef __m128 lanes_t;
+    inline lanes_t set1(float f) noexcept                   { return _mm_set1_ps(f); }
+    inline lanes_t load(const float* p) noexcept            { return _mm_loadu_ps(p); }
+    inline void    store(float* p, lanes_t a) noexcept      { _mm_storeu_ps(p, a); }
+    inline lanes_t add(lanes_t a, lanes_t b) noexcept       { return _mm_add_ps(a, b); }
+    inline lanes_t sub(lanes_t a, lanes_t b) noexcept       { return _mm_sub_ps(a, b); }
+    inline lanes_t mul(lanes_t a, lanes_t b) noexcept       { return _mm_mul_ps(a, b); }
+    inline lanes_t div(lanes_t a, lanes_t b) noexcept       { return _mm_div_ps(a, b); }
+    inline lanes_t min(lanes_t a, lanes_t b) noexcept       { return _mm_min_ps(a, b); }
+    inline lanes_t land(lanes_t a, lanes_t b) noexcept      { return _mm_and_ps(a, b); }
+    inline lanes_t lor(lanes_t a, lanes_t b) noexcept       { return _mm_or_ps(a, b); }
+    inline lanes_t ge(lanes_t a, lanes_t b) noexcept        { return _mm_cmpge_ps(a, b); }
+    inline lanes_t le(lanes_t a, lanes_t b) noexcept        { return _mm_cmple_ps(a, b); }
+    inline lanes_t gt(lanes_t a, lanes_t b) noexcept        { return _mm_cmpgt_ps(a, b); }
+    inline lanes_t eq(lanes_t a, lanes_t b) noexcept        { return _mm_cmpeq_ps(a, b); }
+    inline int     mask(lanes_t a) noexcept                 { return _mm_movemask_ps(a); }
+    //! Renvoie @b a là où @b m est vrai, @b b sinon.
+    inline lanes_t select(lanes_t m, lanes_t a, lanes_t b) noexcept { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    //! Renvoie le minimum des 4 voies, dans chaque voie.
+    inline lanes_t hmin(lanes_t a) noexcept
+    {
+        a = _mm_min_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_min_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+#endif
+}
+
+/**
+ * @struct TrianglePacket
+ * @brief PACKET_WIDTH triangles rangés en SoA : le sommet a et les arêtes ab, ac.
+ * @details Les voies inutilisées du dernier paquet sont des triangles dégénérés (tout à 0),
+ * qui sont rejetés par le test sur le déterminant.
+ */
+struct TrianglePacket
+{
+    float ax[PACKET_WIDTH], ay[PACKET_WIDTH], az[PACKET_WIDTH];    //!< Le sommet a.
+    float abx[PACKET_WIDTH], aby[PACKET_WIDTH], abz[PACKET_WIDTH]; //!< L'arête ab.
+    float acx[PACKET_WIDTH], acy[PACKET_WIDTH], acz[PACKET_WIDTH]; //!< L'arête ac.
+
+    /**
+     * @brief Range @b triangles dans des paquets, le triangle i va dans la voie i%PACKET_WIDTH du paquet i/PACKET_WIDTH.
+     * @param[in]  triangles Les triangles de la scène.
+     * @param[out] packets   Les paquets construits, remplacés.
+     */
+    static void build(const std::vector<Triangle>& triangles, std::vector<TrianglePacket>& packets)
+    {
+        packets.assign((triangles.size() + PACKET_WIDTH - 1)/PACKET_WIDTH, TrianglePacket());
+        for(std::size_t i=0;i<triangles.size();++i)
+        {
+            TrianglePacket& p    = packets[i/PACKET_WIDTH];
+            const int       lane = i%PACKET_WIDTH;
+            const Point     a(triangles[i].a);
+            const Vector    ab(a, Point(triangles[i].b));
+            const Vector    ac(a, Point(triangles[i].c));
+            p.ax[lane]  = a.x;  p.ay[lane]  = a.y;  p.az[lane]  = a.z;
+            p.abx[lane] = ab.x; p.aby[lane] = ab.y; p.abz[lane] = ab.z;
+            p.acx[lane] = ac.x; p.acy[lane] = ac.y; p.acz[lane] = ac.z;
+        }
+    }
+
+    /**
+     * @brief Calcule l'intersection de @b ray avec les PACKET_WIDTH triangles à la fois.
+     * @details Mêmes calculs et mêmes conventions que Triangle::intersect, voie par voie.
+     * @param[in]  ray   Le rayon à tester.
+     * @param[in]  htmax L'abscisse maximale acceptée.
+     * @param[out] t     Le t de chaque voie.
+     * @param[out] u     La coordonnée barycentrique u de chaque voie.
+     * @param[out] v     La coordonnée barycentrique v de chaque voie.
+     * @return Le masque des voies dont l'intersection est valide.
+     */
+    packet::lanes_t intersect(const Ray& ray, const float htmax, packet::lanes_t& t, packet::lanes_t& u, packet::lanes_t& v) const noexcept
+    {
+        using namespace packet;
+        const lanes_t dx = set1(ray.d.x), dy = set1(ray.d.y), dz = set1(ray.d.z);
+        const lanes_t acX = load(acx), acY = load(acy), acZ = load(acz);
+        const lanes_t abX = load(abx), abY = load(aby), abZ = load(abz);
+
+        // pvec = cross(d, ac), det = dot(ab, pvec)
+        const lanes_t px  = sub(mul(dy, acZ), mul(dz, acY));
+        const lanes_t py  = sub(mul(dz, acX), mul(dx, acZ));
+        const lanes_t pz  = sub(mul(dx, acY), mul(dy, acX));
+        const lanes_t det = add(add(mul(abX, px), mul(abY, py)), mul(abZ, pz));
+        lanes_t valid     = lor(le(det, set1(-EPSILON)), ge(det, set1(EPSILON)));
+        const lanes_t inv = div(set1(1.0f), det);
+
+        // tvec = o - a, u = dot(tvec, pvec) / det
+        const lanes_t tx = sub(set1(ray.o.x), load(ax));
+        const lanes_t ty = sub(set1(ray.o.y), load(ay));
+        const lanes_t tz = sub(set1(ray.o.z), load(az));
+        u     = mul(add(add(mul(tx, px), mul(ty, py)), mul(tz, pz)), inv);
+        valid = land(valid, land(ge(u, set1(0.0f)), le(u, set1(1.0f))));
+
+        // qvec = cross(tvec, ab), v = dot(d, qvec) / det
+        const lanes_t qx = sub(mul(ty, abZ), mul(tz, abY));
+        const lanes_t qy = sub(mul(tz, abX), mul(tx, abZ));
+        const lanes_t qz = sub(mul(tx, abY), mul(ty, abX));
+        v     = mul(add(add(mul(dx, qx), mul(dy, qy)), mul(dz, qz)), inv);
+        valid = land(valid, land(ge(v, set1(0.0f)), le(add(u, v), set1(1.0f))));
+
+        // t = dot(ac, qvec) / det
+        t     = mul(add(add(mul(acX, qx), mul(acY, qy)), mul(acZ, qz)), inv);
+        return land(valid, land(le(t, set1(htmax)), gt(t, set1(EPSILON))));
+    }
+
+    /**
+     * @brief Trouve l'intersection la plus proche parmi les triangles du paquet, par réduction sur les voies.
+     * @details En cas d'égalité, la dernière voie l'emporte, comme dans un parcours séquentiel.
+     * @param[in]  ray   Le rayon à tester.
+     * @param[in]  htmax L'abscisse maximale acceptée.
+     * @param[out] rt    Le t de l'intersection retenue.
+     * @param[out] ru    La coordonnée barycentrique u de l'intersection retenue.
+     * @param[out] rv    La coordonnée barycentrique v de l'intersection retenue.
+     * @return La voie retenue, -1 si aucune intersection n'est valide.
+     */
+    int closest(const Ray& ray, const float htmax, float& rt, float& ru, float& rv) const noexcept
+    {
+        using namespace packet;
+        lanes_t t, u, v;
+        const lanes_t valid = this->intersect(ray, htmax, t, u, v);
+        if (mask(valid) == 0)
+        {
+            return -1;
+        }
+        const lanes_t masked = select(valid, t, set1(FLT_MAX));
+        const int     lanes  = mask(land(valid, eq(masked, hmin(masked))));
+        int lane = PACKET_WIDTH - 1;
+        while(!(lanes & (1 << lane)))
+        {
+            --lane;
+        }
+        float ts[PACKET_WIDTH], us[PACKET_WIDTH], vs[PACKET_WIDTH];
+        store(ts, t);
+        store(us, u);
+        store(vs, v);
+        rt = ts[lane];
+        ru = us[lane];
+        rv = vs[lane];
+        return lane;
+    }
+
+    /**
+     * @brief Vérifie si l'un des triangles du paquet coupe @b ray.
+     * @param[in] ray Le rayon à tester, limité par son tmax.
+     * @return true si au moins une voie est valide.
+     */
+    bool any(const Ray& ray) const noexcept
+    {
+        packet::lanes_t t, u, v;
+        return packet::mask(this->intersect(ray, ray.tmax, t, u, v)) != 0;
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file tonemapper.cpp
+ */
+#include <cassert>
+#include <cmath>
+
+#include "tonemapper.hpp"
+#include "core/math_core.hpp"
+
+namespace
+{
+    /**
+     * @struct GammaOperator
+     * @brief Aucune compression, seule la courbe gamma est appliquée.
+     */
+    struct GammaOperator final
+    {
+        static float map(float x) noexcept
+        {
+            return x;
+        }
+    };
+
+    /**
+     * @struct ReinhardOperator
+     * @brief x/(1+x), par canal.
+     */
+    struct ReinhardOperator final
+    {
+        static float map(float x) noexcept
+        {
+            return x/(1.0f + x);
+        }
+    };
+
+    /**
+     * @struct AcesOperator
+     * @brief L'approximation de la courbe ACES par Narkowicz, bornée à [0, 1].
+     */
+    struct AcesOperator final
+    {
+        static float map(float x) noexcept
+        {
+            const float y = (x*(2.51f*x + 0.03f))/(x*(2.43f*x + 0.59f) + 0.14f);
+            return std::min(std::max(y, 0.0f), 1.0f);
+        }
+    };
+
+    /**
+     * @brief Applique @b Operator puis la courbe gamma sur les canaux rgb de chaque pixel.
+     * @details La courbe passe par fastPow, sans branchement, pour que la boucle reste vectorisable.
+     * @tparam Operator Fournit float map(float) en statique.
+     * @see TonemapPass pour les paramètres.
+     */
+    template<typename Operator>
+    void tonemapPass(Color* pixels, int count, float gamma)
+    {
+        assert(std::abs(gamma) > TONEMAPPER_EPSILON);
+        const float exponent = 1.0f/gamma;
+        #pragma omp parallel for schedule(static)
+        for(int i=0;i<count;++i)
+        {
+            Color& pixel = pixels[i];
+            pixel.r = fastPow(Operator::map(pixel.r), exponent);
+            pixel.g = fastPow(Operator::map(pixel.g), exponent);
+            pixel.b = fastPow(Operator::map(pixel.b), exponent);
+        }
+    }
+}
+
+
+TonemapFactory::TonemapFactory(void) : Factory<std::string, TonemapPass>()
+{
+    this->addRecipes(
+        "gamma",    [](void) -> TonemapPass {return &tonemapPass<GammaOperator>;},
+        "reinhard", [](void) -> TonemapPass {return &tonemapPass<ReinhardOperator>;},
+        "aces",     [](void) -> TonemapPass {return &tonemapPass<AcesOperator>;}
+    );
+}
@@ -1,42 +1,38 @@
+/**
+ * @file tonemapper.hpp
+ * @brief Le tonemapping, appliqué en une seule passe sur l'image une fois le rendu terminé.
+ * @author Laurent BARDOUX p1108365
+ * @author Mehdi   GHESH   p1209574
+ */
 #ifndef TONEMAPPER_HPP
 #define TONEMAPPER_HPP
 
-#include <cmath>   // Il faut -lm
-#include <cassert>
-#include <valarray>
+#include <string>
+
+#include "core/gkit_core.hpp"
+#include "templates/Factory.hpp"
 
-#define Compress(gamma)   (1.0f/(gamma))
-#define Decompress(gamma) (gamma)
 #define TONEMAPPER_EPSILON 0.0001f
-typedef std::valarray<float> tonemapped_color_t;
 
+/**
+ * @brief Une passe de tonemapping sur des pixels contigus, en place.
+ * @param[in,out] pixels Les pixels en luminance linéaire, remplacés par leur version affichable.
+ * @param[in]     count  Le nombre de pixels, toute l'image ou une bande de lignes.
+ * @param[in]     gamma  Le gamma de l'écran, la courbe appliquée est x^(1/gamma).
+ * @pre gamma doit etre différent de 0.
+ */
+typedef void (*TonemapPass)(Color* pixels, int count, float gamma);
 
 /**
- * @brief Renvoie une couleur tonnemappée
- * 
- * Cette fonction va appliquer le tonnemapping avec la valeur de gamma.\n
- * Elle permet de compresser et décompresser la valeur passée en paramètre.\n
- * Ainsi, pour compresser, il faut passer une valeur comprise entre 0 et 1
- *
- * @param[in]  rgb    Tableau contenant les 3 valeurs rgb à tonnemapper
- * @param[in]  gamma  Valeur du gamma pour la compression
- * @pre        gamma doit etre différent de 0.
- *
- * @return     La couleur tonemappée selon gamma
- * Par exemple :
- * @code
- * tonemapped_color_t mappedColor = tonemapper({0.1, 0.12, 0.1});
- * tonemapped_color_t mappedColor = tonemapper({0.1, 0.12, 0.1}, Compress(2.0f));
- * tonemapped_color_t mappedColor = tonemapper({0.1, 0.12, 0.1}, Decompress(2.0f));
- * @endcode
+ * @class TonemapFactory
+ * @brief Fabrique la passe de tonemapping via son nom dans image.xml.
+ * @details Opérateurs disponibles : "gamma" (la courbe seule), "reinhard" et "aces".
  */
-tonemapped_color_t tonemapper(const tonemapped_color_t& rgb, const float gamma = Compress(2.2f))
+class TonemapFactory final : public Factory<std::string, TonemapPass>
 {
-    assert(std::abs(gamma) > TONEMAPPER_EPSILON);
-    return std::pow(rgb, gamma);
-}
-
+    public:
+        TonemapFactory(void);
+};
 
 
 #endif
-